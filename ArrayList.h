@@ -4,6 +4,8 @@
 #include <functional>
 #include <random>
 
+#include "Search.h"
+
 template <typename T>
 class ArrayList {
 public:
@@ -13,6 +15,8 @@ public:
     T get(int index);
     int size();
     bool contains(T value);
+    int indexOf(T value);
+    int count(T value);
     void display();
     void add (T value);
 
@@ -59,12 +63,18 @@ int ArrayList<T>::size() {
 
 template <typename T>
 bool ArrayList<T>::contains(T value) {
-    for (const auto& elem : data) {
-        if (elem == value) {
-            return true;
-        }
-    }
-    return false;
+    return searchIndex(data.data(), (long)data.size(), value) >= 0;
+}
+
+// first position holding value, -1 if none
+template <typename T>
+int ArrayList<T>::indexOf(T value) {
+    return searchIndex(data.data(), (long)data.size(), value);
+}
+
+template <typename T>
+int ArrayList<T>::count(T value) {
+    return searchCount(data.data(), (long)data.size(), value);
 }
 
 template <typename T>
@@ -87,7 +97,7 @@ void ArrayList<T>::resize(int newSize) {
 
 template <typename T>
 void ArrayList<T>::add(T value) {
-    if (data.size() < maxSize) {
+    if ((int)data.size() < maxSize) {
         data.push_back(value);
     } else {
         resize(maxSize * 2);
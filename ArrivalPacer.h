@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+
+#include "Locks.h"
+
+// Open-loop arrivals for one issuing thread: next() returns when the next
+// operation is due and hands back the time it was due, which is what latency
+// is measured from. A thread that falls behind issues its late operations
+// back to back and each is charged the time since its intended arrival, so
+// stalls show up in the tail instead of silently lowering the offered load
+// (coordinated omission). Interarrival times are
+//   constant - exactly 1 / rate
+//   poisson  - exponentially distributed with mean 1 / rate
+// A rate of 0 disables pacing and next() returns 0 without waiting.
+class ArrivalPacer {
+public:
+    enum Distribution { CONSTANT, POISSON };
+
+    ArrivalPacer(double _rate, Distribution _distribution, unsigned long seed);
+
+    static Distribution distributionNamed(const std::string& name);
+    static long now();
+    bool pacing() const;
+    long next();
+
+private:
+    static const long SLEEPNS = 100000; // further ahead than this sleeps instead of spinning
+
+    double rate; // operations per second
+    Distribution distribution;
+    std::mt19937_64 gen;
+    std::exponential_distribution<double> gap;
+    double due; // ns on the steady clock, 0 before the first call
+};
+
+inline ArrivalPacer::ArrivalPacer(double _rate, Distribution _distribution, unsigned long seed)
+    : rate(_rate), distribution(_distribution), gen(seed), gap(_rate > 0 ? _rate / 1e9 : 1.0), due(0.0) {
+    if (rate < 0) {
+        throw std::invalid_argument("Arrival rate cannot be negative");
+    }
+}
+
+inline ArrivalPacer::Distribution ArrivalPacer::distributionNamed(const std::string& name) {
+    if (name == "constant") return CONSTANT;
+    if (name == "poisson") return POISSON;
+    throw std::invalid_argument("Unknown arrival distribution " + name + ", expected constant or poisson");
+}
+
+inline long ArrivalPacer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline bool ArrivalPacer::pacing() const {
+    return rate > 0;
+}
+
+inline long ArrivalPacer::next() {
+    if (rate <= 0) {
+        return 0;
+    }
+    if (due == 0.0) {
+        due = now();
+    }
+    due += distribution == CONSTANT ? 1e9 / rate : gap(gen);
+    long ahead = (long)due - now();
+    if (ahead > SLEEPNS) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ahead - SLEEPNS / 2));
+    }
+    while (now() < (long)due) {
+        cpuRelax();
+    }
+    return (long)due;
+}
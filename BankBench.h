@@ -0,0 +1,927 @@
+#pragma once
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <memory>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <random>
+
+#include "BenchUtil.h"
+#include "Config.h"
+#include "Record.h"
+#include "EnergySampler.h"
+#include "Placement.h"
+#include "Migration.h"
+#include "Governor.h"
+#include "LockProfile.h"
+#include "LatencyHistogram.h"
+#include "ArrivalPacer.h"
+#include "Trace.h"
+#include "KeyDistribution.h"
+#include "Ledger.h"
+#include "SnapshotLedger.h"
+#include "ShardedLedger.h"
+#include "Locks.h"
+#include "Combiner.h"
+#include "MPMCQueue.h"
+
+#define CENTS 100 // amounts are stored as integer cents
+
+// The bank transfer benchmark that used to be bank.cpp, bank2.cpp and
+// bank3.cpp, parameterized on the account lock and the ledger. The old
+// programs are the three values of the mode setting:
+//   queue - depositors hand audits to dedicated balance threads (bank.cpp)
+//   split - fixed numbers of deposit-only and balance-only threads (bank2.cpp)
+//   mixed - every thread deposits and audits inline (bank3.cpp)
+template <typename Lock, typename Bank>
+class BankBench {
+public:
+    BankBench(const Config& _cfg, EnergySampler& _sampler, Placement& _placement);
+    bool run(Record& rec);
+
+private:
+    // per-thread state of the deposit path
+    struct OpState {
+        long deposits = 0;
+        long sampled = 0;
+        double latencyNs = 0.0;
+        std::vector<Transfer> batch;
+        long intended = 0; // open loop: when the current operation was due
+        std::vector<std::pair<long, bool>> pending; // open loop: due time and hotness of the batched transfers
+        HotColdStats keys;
+    };
+
+    // operation types with an open-loop latency histogram; deposits are also
+    // split by account hotness
+    enum LatencyOp { DEPOSIT, AUDIT, HOT_DEPOSIT, COLD_DEPOSIT, LATENCYOPS };
+
+    const Config& cfg;
+    EnergySampler& sampler;
+    Placement& placement;
+    std::string mode;
+    int threads;
+    int balanceThreads;
+    int accounts;
+    int chance;
+    int batchSize;
+    int combiners;
+    int latencySample;
+    int auditBatch;
+    long iterations;
+    long long expected;
+    bool verifying; // the sharded verifier pauses depositors through threadMutexes
+    bool migrating; // lock wait/hold times are only taken while migration runs
+    double rate; // offered operations/s across all issuing threads, 0 for closed loop
+    uint64_t seed; // per-thread generator seed, 0 for unseeded
+    ArrivalPacer::Distribution arrival;
+
+    std::unique_ptr<Bank> bank;
+    std::unique_ptr<Lock[]> mutexes;
+    std::unique_ptr<std::shared_mutex[]> threadMutexes;
+    MPMCQueue<long> auditQueue; // due time per pending audit, 0 in closed loop
+    Combiner combiner;
+    std::vector<ThreadStats> stats;
+    std::unique_ptr<ThreadActivity[]> activity;
+    MigrationController migration;
+    Governor governor; // ranks are writer thread numbers
+    WorkPool pool; // writer operations
+    LockProfiler profiler;
+    LockStats* accountLocks; // per mutexes entry, null unless lockprofile is set
+    LockStats* threadLocks; // per threadMutexes entry
+    std::vector<LatencyHistogram> latency; // LATENCYOPS per thread, open loop only
+    std::unique_ptr<Trace> trace; // writer operations are replayed from here when set
+    KeyDistribution accountKeys;
+    std::vector<HotColdStats> keyStats; // per thread, deposits by account hotness
+
+    void createBank(std::unique_ptr<Ledger<false>>& b);
+    void createBank(std::unique_ptr<Ledger<true>>& b);
+    void createBank(std::unique_ptr<SnapshotLedger>& b);
+    void createBank(std::unique_ptr<ShardedLedger<false>>& b);
+    void createBank(std::unique_ptr<ShardedLedger<true>>& b);
+
+    void lockAccount(int acct);
+    void unlockAccount(int acct);
+    void lockThread(int threadNum);
+    void unlockThread(int threadNum);
+    void lockAllThreadsShared();
+    void unlockAllThreadsShared();
+    static std::vector<long>& sharedSince();
+    bool drawAccounts(int& acct1, int& acct2);
+    TraceOp generateOp(bool depositOnly);
+    TraceOp nextOp(TraceCursor& cursor, bool depositOnly);
+    void startThread(int threadNum);
+    void loadTrace(int writers, long quota, Record& rec);
+    void applyDeposit(bool audited, bool lockAccounts, int threadNum, int acct1, int acct2, uint32_t fraction);
+    void depositBatch(bool threaded, int threadNum, std::vector<Transfer>& batch);
+    ArrivalPacer pacer(int threadNum, double share);
+    void completed(int threadNum, LatencyOp type, long intended);
+    void completedDeposit(int threadNum, long intended, bool hot);
+    void transferOp(bool threaded, int threadNum, OpState& op, const TraceOp& o);
+    void flushOps(bool threaded, int threadNum, OpState& op);
+    long lockClock() const;
+    long long balance(bool threaded, int threadNum = -1);
+    bool checkBalance(const char* who);
+
+    void do_work(int threadNum);
+    void do_work_mixed(int threadNum, bool threaded);
+    void do_work_deposit(int threadNum);
+    void do_work_audit(int threadNum, long iter);
+    void do_work_balance(int threadNum);
+    void finish(int threadNum, std::chrono::high_resolution_clock::time_point t1, const OpState& op,
+                const char* label);
+};
+
+template <typename Lock, typename Bank>
+BankBench<Lock, Bank>::BankBench(const Config& _cfg, EnergySampler& _sampler, Placement& _placement)
+    : cfg(_cfg), sampler(_sampler), placement(_placement), auditQueue(cfg.getInt("queuesize")),
+      combiner(cfg.getInt("threads")), activity(new ThreadActivity[std::max(1L, cfg.getInt("threads"))]),
+      migration(_placement.topology(), std::max(1L, cfg.getInt("threads")), activity.get()),
+      governor(std::max(1L, cfg.getInt("threads") - (cfg.getString("mode") == "mixed" ? 0 : cfg.getInt("balancethreads"))),
+               cfg.getInt("minthreads")),
+      pool(std::max(1L, cfg.getInt("threads")), &governor),
+      accountKeys(std::max(1L, cfg.getInt("accounts")), cfg.getString("keydist"), cfg.getDouble("zipftheta"),
+                  cfg.getDouble("hotkeys"), cfg.getDouble("hotops"), cfg.getInt("burstms")) {
+    mode = cfg.getString("mode");
+    threads = cfg.getInt("threads");
+    balanceThreads = mode == "mixed" ? 0 : cfg.getInt("balancethreads");
+    accounts = cfg.getInt("accounts");
+    chance = cfg.getInt("chance");
+    batchSize = std::max(1L, cfg.getInt("batch"));
+    combiners = std::max(0L, cfg.getInt("combiners"));
+    latencySample = std::max(1L, cfg.getInt("latencysample"));
+    auditBatch = std::max(1L, cfg.getInt("auditbatch"));
+    iterations = cfg.getInt("iterations");
+    expected = (long long)cfg.getInt("total") * CENTS;
+    if (mode != "queue" && mode != "split" && mode != "mixed") {
+        throw std::invalid_argument("Unknown bank mode " + mode + ", expected queue, split or mixed");
+    }
+    if (threads <= 0 || balanceThreads < 0 || balanceThreads >= threads || accounts < 2) {
+        throw std::invalid_argument("Need accounts >= 2 and 0 <= balancethreads < threads");
+    }
+    // every account starts with the same whole number of cents, so drop the
+    // remainder the audits could never find
+    expected -= expected % accounts;
+    createBank(bank);
+    mutexes.reset(new Lock[accounts]);
+    threadMutexes.reset(new std::shared_mutex[threads]);
+    stats.resize(threads);
+    keyStats.resize(threads);
+    verifying = false;
+    migrating = false;
+    accountLocks = nullptr;
+    threadLocks = nullptr;
+    rate = cfg.getDouble("rate");
+    seed = cfg.getInt("seed");
+    arrival = ArrivalPacer::distributionNamed(cfg.getString("arrival"));
+    if(rate > 0){
+        latency.resize(threads * LATENCYOPS);
+    }
+    if(cfg.getInt("lockprofile") != 0){
+        accountLocks = profiler.group("account", accounts);
+        threadLocks = profiler.group("thread", threads);
+    }
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::createBank(std::unique_ptr<Ledger<false>>& b) {
+    b.reset(new Ledger<false>(accounts, expected / accounts));
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::createBank(std::unique_ptr<Ledger<true>>& b) {
+    b.reset(new Ledger<true>(accounts, expected / accounts));
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::createBank(std::unique_ptr<SnapshotLedger>& b) {
+    b.reset(new SnapshotLedger(accounts, expected / accounts, threads));
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::createBank(std::unique_ptr<ShardedLedger<false>>& b) {
+    b.reset(new ShardedLedger<false>(accounts, expected / accounts, threads, cfg.getInt("shards")));
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::createBank(std::unique_ptr<ShardedLedger<true>>& b) {
+    b.reset(new ShardedLedger<true>(accounts, expected / accounts, threads, cfg.getInt("shards")));
+}
+
+// Lock helpers that time the acquisition and hold when profiling
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::lockAccount(int acct) {
+    if(accountLocks){
+        profiledLock(mutexes[acct], accountLocks[acct]);
+    } else {
+        mutexes[acct].lock();
+    }
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::unlockAccount(int acct) {
+    if(accountLocks){
+        profiledUnlock(mutexes[acct], accountLocks[acct]);
+    } else {
+        mutexes[acct].unlock();
+    }
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::lockThread(int threadNum) {
+    if(threadLocks){
+        profiledLock(threadMutexes[threadNum], threadLocks[threadNum]);
+    } else {
+        threadMutexes[threadNum].lock();
+    }
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::unlockThread(int threadNum) {
+    if(threadLocks){
+        profiledUnlock(threadMutexes[threadNum], threadLocks[threadNum]);
+    } else {
+        threadMutexes[threadNum].unlock();
+    }
+}
+
+// audits and the verifier hold every thread lock shared
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::lockAllThreadsShared() {
+    std::vector<long>& since = sharedSince();
+    since.resize(threads);
+    for(int i = 0; i < threads; i++){
+        if(threadLocks){
+            since[i] = profiledLockShared(threadMutexes[i], threadLocks[i]);
+        } else {
+            threadMutexes[i].lock_shared();
+        }
+    }
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::unlockAllThreadsShared() {
+    std::vector<long>& since = sharedSince();
+    for(int i = 0; i < threads; i++){
+        if(threadLocks){
+            profiledUnlockShared(threadMutexes[i], threadLocks[i], since[i]);
+        } else {
+            threadMutexes[i].unlock_shared();
+        }
+    }
+}
+
+// acquire times of the calling thread's shared holds
+template <typename Lock, typename Bank>
+std::vector<long>& BankBench<Lock, Bank>::sharedSince() {
+    thread_local std::vector<long> since;
+    return since;
+}
+
+// Two distinct accounts from the key distribution; true if either is hot
+template <typename Lock, typename Bank>
+bool BankBench<Lock, Bank>::drawAccounts(int& acct1, int& acct2) {
+    bool hot1, hot2;
+    acct1 = accountKeys.next(hot1);
+    acct2 = accountKeys.next(hot2);
+    // a one-key hot set with hotops=1, or steep zipf on few accounts, can
+    // keep drawing acct1: give up after a few tries and take any other account
+    for(int tries = 0; acct1 == acct2 && tries < 8; tries++){
+        acct2 = accountKeys.next(hot2);
+    }
+    if(acct1 == acct2){
+        acct2 = (acct1 + 1 + generateRandomInt(0, accounts - 2)) % accounts;
+        hot2 = false;
+    }
+    return hot1 || hot2;
+}
+
+// A writer operation drawn now: a deposit, or an audit chance% of the time
+template <typename Lock, typename Bank>
+TraceOp BankBench<Lock, Bank>::generateOp(bool depositOnly) {
+    TraceOp o = TraceOp();
+    if(!depositOnly && generateRandomInt(0, 99) >= chance){
+        o.kind = TRACE_AUDIT;
+        return o;
+    }
+    o.kind = TRACE_DEPOSIT;
+    o.flags = drawAccounts(o.a, o.b) ? TRACE_HOT : 0;
+    o.fraction = threadRandom().next32();
+    return o;
+}
+
+template <typename Lock, typename Bank>
+TraceOp BankBench<Lock, Bank>::nextOp(TraceCursor& cursor, bool depositOnly) {
+    return cursor.replaying() ? cursor.next() : generateOp(depositOnly);
+}
+
+// Every worker starts here: with seed set, thread n always draws the same sequence
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::startThread(int threadNum) {
+    if(seed != 0){
+        seedThreadRandom(seed, threadNum);
+    }
+}
+
+// tracemode=record writes each writer's quota of operations to the trace
+// first; either way the trace is mapped and checked before the clock starts
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::loadTrace(int writers, long quota, Record& rec) {
+    std::string path = cfg.getString("trace");
+    std::string traceMode = cfg.getString("tracemode");
+    if(traceMode == "record"){
+        uint64_t traceSeed = seed != 0 ? seed : threadRandom().next();
+        std::vector<std::vector<TraceOp>> streams(writers);
+        for(int i = 0; i < writers; i++){
+            seedThreadRandom(traceSeed, i);
+            for(long k = 0; k < quota; k++){
+                streams[i].push_back(generateOp(mode == "split"));
+            }
+        }
+        Trace::write(path, streams, traceSeed);
+    } else if(traceMode != "replay"){
+        throw std::invalid_argument("Unknown tracemode " + traceMode + ", expected replay or record");
+    }
+    trace.reset(new Trace(path));
+    if(trace->threads() < writers){
+        throw std::runtime_error("Trace " + path + " has " + std::to_string(trace->threads()) + " streams, " +
+                                 std::to_string(writers) + " writers need one each");
+    }
+    for(int t = 0; t < trace->threads(); t++){
+        const TraceOp* ops = trace->ops(t);
+        for(long k = 0; k < trace->count(t); k++){
+            if(ops[k].kind == TRACE_DEPOSIT && (ops[k].a < 0 || ops[k].a >= accounts || ops[k].b < 0 ||
+                                                ops[k].b >= accounts || ops[k].a == ops[k].b)){
+                throw std::runtime_error("Trace " + path + " has accounts outside 0.." + std::to_string(accounts - 1));
+            }
+            if(ops[k].kind != TRACE_DEPOSIT && ops[k].kind != TRACE_AUDIT){
+                throw std::runtime_error("Trace " + path + " is not a bank trace");
+            }
+        }
+    }
+    std::cout << "Replaying " << trace->total() << " operations from " << path << " (seed " << trace->seed() << ")" << std::endl;
+    rec.add("trace_ops", trace->total());
+    rec.add("trace_seed", std::to_string(trace->seed()));
+}
+
+// audited takes the caller's threadMutexes entry, lockAccounts the two account
+// locks; the amount is fraction scaled onto acct1's balance
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::applyDeposit(bool audited, bool lockAccounts, int threadNum, int acct1, int acct2,
+                                         uint32_t fraction) {
+    audited = audited && (!Bank::consistentBalance || verifying);
+    long t0 = lockClock();
+    if(audited){
+        lockThread(threadNum);
+    }
+    if(lockAccounts){
+        //prevent deadlocking
+        if(acct1 < acct2){
+            lockAccount(acct1);
+            lockAccount(acct2);
+        }
+        else{
+            lockAccount(acct2);
+            lockAccount(acct1);
+        }
+    }
+    long t1 = lockClock();
+    //has to happen before getting the amount because otherwise we could be getting nonexistant amounts
+    long long amt = scaleFraction(fraction, bank->get(acct1));
+    bank->transfer(threadNum, acct1, acct2, amt);
+    long t2 = lockClock();
+    if(audited){
+        unlockThread(threadNum);
+    }
+    if(lockAccounts){
+        unlockAccount(acct1);
+        unlockAccount(acct2);
+    }
+    if(migrating){
+        activity[threadNum].add(t1 - t0, t2 - t1);
+    }
+}
+
+// Applies a whole batch under one acquisition of the union of its account
+// locks. Locks are taken in ascending account order, the same order applyDeposit()
+// uses, so batches cannot deadlock with each other or with single transfers.
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::depositBatch(bool threaded, int threadNum, std::vector<Transfer>& batch) {
+    thread_local std::vector<int> accts;
+    accts.clear();
+    for(const Transfer& t : batch){
+        accts.push_back(t.from);
+        accts.push_back(t.to);
+    }
+    std::sort(accts.begin(), accts.end());
+    accts.erase(std::unique(accts.begin(), accts.end()), accts.end());
+
+    bool audited = threaded && (!Bank::consistentBalance || verifying);
+    long t0 = lockClock();
+    if(audited){
+        lockThread(threadNum);
+    }
+    if(threaded){
+        for(int acct : accts){
+            lockAccount(acct);
+        }
+    }
+    long t1 = lockClock();
+    //amounts are drawn in batch order against balances that include the earlier legs
+    for(size_t i = 0; i < batch.size(); i++){
+        long long available = bank->get(batch[i].from);
+        for(size_t j = 0; j < i; j++){
+            if(batch[j].from == batch[i].from) available -= batch[j].amt;
+            if(batch[j].to == batch[i].from) available += batch[j].amt;
+        }
+        batch[i].amt = scaleFraction((uint32_t)batch[i].amt, available); // queued holding the fraction
+    }
+    bank->transferBatch(threadNum, batch.data(), batch.size());
+    long t2 = lockClock();
+    if(audited){
+        unlockThread(threadNum);
+    }
+    if(threaded){
+        for(auto it = accts.rbegin(); it != accts.rend(); ++it){
+            unlockAccount(*it);
+        }
+    }
+    if(migrating){
+        activity[threadNum].add(t1 - t0, t2 - t1);
+    }
+    batch.clear();
+}
+
+// Arrivals for a thread issuing share of the offered rate
+template <typename Lock, typename Bank>
+ArrivalPacer BankBench<Lock, Bank>::pacer(int threadNum, double share) {
+    std::random_device rd;
+    return ArrivalPacer(rate * share, arrival, ((seed != 0 ? seed : (unsigned long)rd()) << 16) ^ threadNum);
+}
+
+// Charges an open-loop operation the time since it was due
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::completed(int threadNum, LatencyOp type, long intended) {
+    if(intended != 0){
+        latency[threadNum * LATENCYOPS + type].record(ArrivalPacer::now() - intended);
+    }
+}
+
+// a deposit is charged to the overall histogram and to its hot or cold one
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::completedDeposit(int threadNum, long intended, bool hot) {
+    completed(threadNum, DEPOSIT, intended);
+    completed(threadNum, hot ? HOT_DEPOSIT : COLD_DEPOSIT, intended);
+}
+
+// One deposit through whichever path is configured: delegated to a combiner,
+// batched, or locked by the caller (timed 1 in latencySample)
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::transferOp(bool threaded, int threadNum, OpState& op, const TraceOp& o) {
+    using namespace std::chrono;
+    bool hot = (o.flags & TRACE_HOT) != 0;
+    if (threaded && combiners > 0) {
+        double ns = combiner.submit(threadNum, o.a, o.b, o.fraction);
+        op.latencyNs += ns;
+        op.sampled++;
+        op.keys.latencyNs[hot] += ns;
+        op.keys.sampled[hot]++;
+        completedDeposit(threadNum, op.intended, hot);
+    } else if (batchSize > 1) {
+        op.batch.push_back(Transfer{o.a, o.b, o.fraction});
+        if (op.intended != 0) {
+            op.pending.push_back({op.intended, hot});
+        }
+        if ((int)op.batch.size() == batchSize) {
+            flushOps(threaded, threadNum, op);
+        }
+    } else if (op.deposits % latencySample == 0) {
+        steady_clock::time_point start = steady_clock::now();
+        applyDeposit(threaded, threaded, threadNum, o.a, o.b, o.fraction);
+        double ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+        op.latencyNs += ns;
+        op.sampled++;
+        op.keys.latencyNs[hot] += ns;
+        op.keys.sampled[hot]++;
+        completedDeposit(threadNum, op.intended, hot);
+    } else {
+        applyDeposit(threaded, threaded, threadNum, o.a, o.b, o.fraction);
+        completedDeposit(threadNum, op.intended, hot);
+    }
+    op.deposits++;
+    op.keys.ops[hot]++;
+}
+
+// a batched transfer completes when its batch is applied
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::flushOps(bool threaded, int threadNum, OpState& op) {
+    if (!op.batch.empty()) {
+        depositBatch(threaded, threadNum, op.batch);
+    }
+    for (const std::pair<long, bool>& p : op.pending) {
+        completedDeposit(threadNum, p.first, p.second);
+    }
+    op.pending.clear();
+}
+
+// ns timestamp while migration is running, 0 otherwise
+template <typename Lock, typename Bank>
+long BankBench<Lock, Bank>::lockClock() const {
+    if(!migrating){
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// threadNum, when given, is charged the wait and hold time
+template <typename Lock, typename Bank>
+long long BankBench<Lock, Bank>::balance(bool threaded, int threadNum) {
+    long long total = 0;
+    threaded = threaded && !Bank::consistentBalance; // the epoch ledgers need no locks
+    long t0 = lockClock();
+    if(threaded){
+        lockAllThreadsShared();
+    }
+    long t1 = lockClock();
+    total = bank->balance();
+    long t2 = lockClock();
+    if(threaded){
+        unlockAllThreadsShared();
+    }
+    if(migrating && threadNum >= 0){
+        activity[threadNum].add(t1 - t0, t2 - t1);
+    }
+    return total;
+}
+
+template <typename Lock, typename Bank>
+bool BankBench<Lock, Bank>::checkBalance(const char* who) {
+    long long tot = balance(true);
+    if (tot != expected) {
+        printf("Balance failed%s: %lld\n", who, tot);
+        return false;
+    }
+    return true;
+}
+
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::finish(int threadNum, std::chrono::high_resolution_clock::time_point t1,
+                                   const OpState& op, const char* label) {
+    using namespace std::chrono;
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    duration<double> exec_time_i = duration_cast<duration<double>>(t2 - t1);
+    stats[threadNum].time = exec_time_i.count();
+    stats[threadNum].ops = op.deposits;
+    stats[threadNum].latencyNs = op.sampled > 0 ? op.latencyNs / op.sampled : 0.0;
+    keyStats[threadNum] = op.keys;
+    std::cout << label << threadNum << " finished in " << exec_time_i.count() << " sec\n";
+}
+
+// queue mode depositor: audits are handed to the balance threads
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::do_work(int threadNum) {
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    startThread(threadNum);
+    OpState op;
+    ArrivalPacer arrivals = pacer(threadNum, 1.0 / (threads - balanceThreads));
+    TraceCursor cursor(trace.get(), threadNum);
+    while (pool.take(threadNum)) {
+        op.intended = arrivals.next();
+        const TraceOp o = nextOp(cursor, false);
+        if (o.kind == TRACE_DEPOSIT) {
+            transferOp(true, threadNum, op, o);
+        } else {
+            auditQueue.push(op.intended); // wakes one parked balance thread, if any
+        }
+    }
+    flushOps(true, threadNum, op);
+    finish(threadNum, t1, op, "Thread ");
+}
+
+// mixed mode, and the single-threaded comparison when threaded is false
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::do_work_mixed(int threadNum, bool threaded) {
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    startThread(threadNum);
+    OpState op;
+    ArrivalPacer arrivals = pacer(threadNum, threaded ? 1.0 / threads : 0.0);
+    TraceCursor cursor(trace.get(), threadNum);
+    while(pool.take(threadNum)){
+        op.intended = arrivals.next();
+        const TraceOp o = nextOp(cursor, false);
+        if(o.kind == TRACE_DEPOSIT){
+            transferOp(threaded, threadNum, op, o);
+        }
+        else{
+            long long tot = balance(threaded, threadNum);
+            if(tot != expected){
+                printf("Balance failed%s: %lld\n", threaded ? "" : " Single", tot);
+            }
+            completed(threadNum, AUDIT, op.intended);
+        }
+    }
+    flushOps(threaded, threadNum, op);
+    finish(threadNum, t1, op, "Thread ");
+}
+
+// split mode deposit-only thread
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::do_work_deposit(int threadNum) {
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    startThread(threadNum);
+    OpState op;
+    ArrivalPacer arrivals = pacer(threadNum, chance / 100.0 / (threads - balanceThreads));
+    TraceCursor cursor(trace.get(), threadNum);
+    while(pool.take(threadNum)){
+        op.intended = arrivals.next();
+        const TraceOp o = nextOp(cursor, true);
+        if(o.kind == TRACE_DEPOSIT){
+            transferOp(true, threadNum, op, o);
+        }
+    }
+    flushOps(true, threadNum, op);
+    finish(threadNum, t1, op, "Deposit thread ");
+}
+
+// split mode balance-only thread
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::do_work_audit(int threadNum, long iter) {
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    OpState op;
+    ArrivalPacer arrivals = pacer(threadNum, (100 - chance) / 100.0 / balanceThreads);
+    for(long i = 0; i < iter; i++){
+        long due = arrivals.next();
+        long long tot = balance(true, threadNum);
+        if(tot != expected){
+            printf("Balance failed: %lld\n", tot);
+        }
+        completed(threadNum, AUDIT, due);
+    }
+    finish(threadNum, t1, op, "Balance Thread ");
+}
+
+// queue mode balance thread: serves audit requests until the queue is closed
+template <typename Lock, typename Bank>
+void BankBench<Lock, Bank>::do_work_balance(int threadNum) {
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    std::vector<long> requests(auditBatch);
+    while (true) {
+        int n = auditQueue.popBatch(requests.data(), auditBatch);
+        for (int r = 0; r < n; r++) {
+            long long tot = balance(true, threadNum);
+            if (tot != expected) {
+                printf("Balance failed: %lld\n", tot);
+            }
+            completed(threadNum, AUDIT, requests[r]); // includes the time spent queued
+        }
+        if (n == 0) { // closed and drained
+            finish(threadNum, t1, OpState(), "Thread ");
+            return;
+        }
+    }
+}
+
+template <typename Lock, typename Bank>
+bool BankBench<Lock, Bank>::run(Record& rec) {
+    using namespace std::chrono;
+    const std::string lockName = cfg.getString("lock");
+    int writers = threads - balanceThreads;
+
+    if constexpr (std::is_same<Bank, ShardedLedger<false>>::value || std::is_same<Bank, ShardedLedger<true>>::value) {
+        long verifyMs = cfg.getInt("verifyms");
+        if(verifyMs > 0){
+            verifying = true;
+            bank->startVerifier(milliseconds(verifyMs),
+                [this] { lockAllThreadsShared(); },
+                [this] { unlockAllThreadsShared(); });
+        }
+    }
+    if constexpr (std::is_same<Lock, AdaptiveLock>::value) {
+        AdaptiveLock::tuner().start([this] { return sampler.meter().read(); },
+                                    cfg.getInt("targetlatencyns"), milliseconds(cfg.getInt("tunems")));
+    }
+    placement.plan(writers, balanceThreads, combiners);
+    std::cout << "Placement " << placement.describe() << std::endl;
+    migrating = cfg.getString("migrate") != "0" && migration.active();
+    if(cfg.getString("migrate") != "0" && !migrating){
+        std::cout << "Migration needs at least two frequency classes, placement stays static" << std::endl;
+    }
+    sampler.beginPhase("parallel");
+    if(combiners > 0){
+        //the requesting worker is blocked in submit(), so its threadMutexes entry is free to use
+        combiner.start(combiners, [this](int slot, Transfer& t) {
+            applyDeposit(true, combiners > 1, slot, t.from, t.to, (uint32_t)t.amt);
+        });
+        for(int c = 0; c < combiners; c++){
+            placement.pin(combiner.handle(c), COMBINER, c);
+        }
+    }
+
+    //writer operations: a fixed quota each, or one shared pool the governor's running threads drain
+    long quota = mode == "split" ? (iterations * chance / 100) / writers : iterations / writers;
+    if(!cfg.getString("trace").empty()){
+        loadTrace(writers, quota, rec);
+    }
+    std::string objective = cfg.getString("governor");
+    bool governed = objective != "off";
+    if(governed){
+        pool.share(quota * writers);
+    } else {
+        for(int i = 0; i < writers; i++){
+            pool.assign(i, quota);
+        }
+    }
+
+    //create threads and do their work
+    std::vector<std::thread> workers(threads);
+    if(mode == "queue"){
+        for(int i = writers; i < threads; i++){
+            workers[i] = placement.spawn(READER, i - writers, [this, i] { do_work_balance(i); });
+        }
+        for(int i = 0; i < writers; i++){
+            workers[i] = placement.spawn(WRITER, i, [this, i] { do_work(i); });
+        }
+    } else if(mode == "split"){
+        long balanceIterations = balanceThreads > 0 ? (iterations * (100 - chance) / 100) / balanceThreads : 0;
+        for(int i = 0; i < writers; i++){
+            workers[i] = placement.spawn(WRITER, i, [this, i] { do_work_deposit(i); });
+        }
+        for(int i = writers; i < threads; i++){
+            workers[i] = placement.spawn(READER, i - writers, [this, i, balanceIterations] { do_work_audit(i, balanceIterations); });
+        }
+    } else {
+        for(int i = 0; i < threads; i++){
+            workers[i] = placement.spawn(WRITER, i, [this, i] { do_work_mixed(i, true); });
+        }
+    }
+    if(governed){
+        governor.start(Governor::objectiveNamed(objective), [this] { return sampler.meter().read(); },
+                       [this] { return pool.done(); }, milliseconds(cfg.getInt("governms")),
+                       cfg.getDouble("powercap"), cfg.getDouble("minthroughput"));
+    }
+    if(migrating){
+        for(int i = 0; i < threads; i++){
+            int cpu = i < writers ? placement.cpuFor(WRITER, i) : placement.cpuFor(READER, i - writers);
+            migration.track(i, workers[i].native_handle(), cpu);
+        }
+        migration.start(milliseconds(cfg.getInt("migratems")), cfg.getDouble("promote"), cfg.getDouble("demote"),
+                        cfg.getInt("dwell"));
+    }
+
+    for(int i = 0; i < writers; i++){
+        migration.release(i);
+        workers[i].join();
+    }
+    governor.stop();
+    if(governed){
+        std::cout << "Governor (" << objective << "): " << governor.meanLimit() << " of " << writers
+                  << " writers active on average, " << governor.steps() << " adjustments" << std::endl;
+    }
+    if(combiners > 0){
+        combiner.stop();
+        std::cout << "Delegation: " << combiners << " combiners applied " << combiner.applied()
+                  << " transfers in " << combiner.sweeps() << " sweeps" << std::endl;
+    }
+    auditQueue.close();
+    for(int i = writers; i < threads; i++){
+        migration.release(i);
+        workers[i].join();
+    }
+    migration.stop();
+    migrating = false;
+    int depositors = mode == "queue" ? writers : threads; // queue mode balance threads only wait
+    long totalTransfers = 0;
+    for(int i = 0; i < depositors; i++){
+        totalTransfers += stats[i].ops;
+    }
+    sampler.endPhase(totalTransfers);
+    if constexpr (std::is_same<Lock, AdaptiveLock>::value) {
+        AdaptiveLock::tuner().stop();
+        std::cout << "Adaptive spin budget: " << AdaptiveLock::tuner().budget() << " ns, parked "
+                  << AdaptiveLock::tuner().parks() << " of " << AdaptiveLock::tuner().acquisitions() << " acquisitions" << std::endl;
+        rec.add("adaptive_budget_ns", AdaptiveLock::tuner().budget());
+    }
+    bool recountOk = true;
+    if constexpr (std::is_same<Bank, ShardedLedger<false>>::value || std::is_same<Bank, ShardedLedger<true>>::value) {
+        bank->stopVerifier();
+        verifying = false;
+        // balance() cannot see a corrupted account here, so check the accounts themselves
+        long long recounted = bank->recount();
+        if (recounted != expected) {
+            printf("Recount failed: %lld\n", recounted);
+            recountOk = false;
+        }
+        rec.add("recount_balance", (long)recounted);
+        std::cout << "Verifications: " << bank->verifications() << " mismatched shards: " << bank->mismatches() << std::endl;
+        rec.add("verifications", bank->verifications());
+        rec.add("verify_mismatches", bank->mismatches());
+    }
+    if(accountLocks){
+        profiler.report(std::cout, cfg.getInt("locktop"));
+        rec.add("lock_acquisitions", profiler.acquisitions());
+        rec.add("lock_contended", profiler.contended());
+        rec.add("lock_wait_ns", profiler.waitNs());
+        rec.add("hottest_lock", profiler.hottest());
+        std::string lockFile = cfg.getString("lockprofilefile");
+        if(!lockFile.empty() && !profiler.writeCsv(lockFile)){
+            std::cerr << "Cannot write lock profile " << lockFile << std::endl;
+        }
+    }
+    bool ok = checkBalance("") && recountOk;
+    if (ok) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+
+    std::cout << "---------" << std::endl;
+    double maxTime = 0.0;
+    double meanLatency = 0.0;
+    for(int i = 0; i < depositors; i++){
+        meanLatency += stats[i].latencyNs / depositors;
+        maxTime = std::max(maxTime, stats[i].time);
+    }
+    double throughput = maxTime > 0 ? totalTransfers / maxTime : 0.0;
+    printf("Total %d Threaded time: %lf seconds\n", threads, maxTime);
+    printf("Lock %s, batch %d, combiners %d: %lf transfers/sec, %.0lf ns mean transfer latency\n",
+           lockName.c_str(), batchSize, combiners, throughput, meanLatency);
+    rec.add("balance_ok", ok);
+    rec.add("misplaced_threads", placement.misplaced());
+    rec.add("migrations", migration.migrations());
+    if(governed){
+        rec.add("governor_mean_threads", governor.meanLimit());
+        rec.add("governor_steps", governor.steps());
+    }
+    rec.add("time_s", maxTime);
+    rec.add("transfers", totalTransfers);
+    rec.add("throughput", throughput);
+    rec.add("latency_ns", meanLatency);
+    if(accountKeys.skewed()){
+        HotColdStats keys;
+        for(int i = 0; i < depositors; i++){
+            keys.add(keyStats[i]);
+        }
+        keys.report("accounts", accountKeys.hotCount(), accounts, rec);
+    }
+    if(rate > 0){
+        rec.add("offered_rate", rate);
+        const char* names[LATENCYOPS] = {"deposit", "audit", "hot_deposit", "cold_deposit"};
+        for(int type = 0; type < LATENCYOPS; type++){
+            if((type == HOT_DEPOSIT || type == COLD_DEPOSIT) && !accountKeys.skewed()){
+                continue;
+            }
+            LatencyHistogram merged;
+            for(int i = 0; i < threads; i++){
+                merged.add(latency[i * LATENCYOPS + type]);
+            }
+            merged.report(names[type], rec);
+        }
+    }
+
+    if(cfg.getInt("sequential") != 0){
+        sampler.beginPhase("sequential");
+        pool.assign(0, iterations);
+        do_work_mixed(0, false);
+        sampler.endPhase(stats[0].ops);
+        printf("Total nonthreaded time: %lf seconds\n", stats[0].time);
+        rec.add("sequential_time_s", stats[0].time);
+    }
+    return ok;
+}
+
+// Picks the lock and ledger named in cfg and runs the bank benchmark.
+// Throws std::invalid_argument for unknown names.
+inline bool runBank(const Config& cfg, EnergySampler& sampler, Placement& placement, Record& rec) {
+    std::string lockName = cfg.getString("lock");
+    std::string audit = cfg.getString("audit");
+    bool padded = cfg.getInt("padded") != 0;
+    if (audit != "locked" && audit != "snapshot" && audit != "incremental") {
+        throw std::invalid_argument("Unknown audit " + audit + ", expected locked, snapshot or incremental");
+    }
+    bool ok = false;
+    bool known = withLockPolicy(lockName, [&](auto policy) {
+        typedef typename decltype(policy)::type Lock;
+        if (audit == "snapshot") {
+            ok = BankBench<Lock, SnapshotLedger>(cfg, sampler, placement).run(rec);
+        } else if (audit == "incremental") {
+            ok = padded ? BankBench<Lock, ShardedLedger<true>>(cfg, sampler, placement).run(rec)
+                        : BankBench<Lock, ShardedLedger<false>>(cfg, sampler, placement).run(rec);
+        } else {
+            ok = padded ? BankBench<Lock, Ledger<true>>(cfg, sampler, placement).run(rec)
+                        : BankBench<Lock, Ledger<false>>(cfg, sampler, placement).run(rec);
+        }
+    });
+    if (!known) {
+        throw std::invalid_argument("Unknown lock " + lockName + ", expected one of: " + lockPolicyNames());
+    }
+    return ok;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+
+#include "BenchUtil.h"
+#include "Config.h"
+#include "Record.h"
+#include "EnergyMeter.h"
+#include "EnergySampler.h"
+#include "Topology.h"
+#include "FrequencyControl.h"
+#include "Placement.h"
+#include "BankBench.h"
+#include "ListBench.h"
+
+// One run of the workload named in cfg, measurements only
+inline bool runWorkload(const Config& cfg, Record& rec) {
+    EnergyMeter meter(EnergyMeter::backendNamed(cfg.getString("energy")), cfg.getString("raplroot"),
+                      cfg.getDouble("simidlewatts"), cfg.getDouble("simcorewatts"));
+    EnergySampler sampler(meter);
+    long sampleMs = cfg.getInt("samplems");
+    if (sampleMs > 0) {
+        sampler.start(std::chrono::milliseconds(sampleMs));
+    }
+    // caps first so the topology sees the frequency classes they create
+    FrequencyControl dvfs(cfg.getString("cpuroot"), cfg.getString("dvfsjournal"));
+    if (!cfg.getString("freqcaps").empty()) {
+        dvfs.apply(cfg.getString("freqcaps"));
+    }
+    Topology topo(cfg.getString("cpuroot"));
+    Placement placement(topo, cfg.getString("placement"));
+    std::cout << "Topology: " << topo.describe() << std::endl;
+    rec.add("freq_classes_by", topo.classedByCapacity() ? "cpu_capacity" : "max_freq");
+    std::string workload = cfg.getString("workload");
+    bool ok;
+    if (workload == "bank") {
+        ok = runBank(cfg, sampler, placement, rec);
+    } else if (workload == "list") {
+        ListBench bench(cfg, sampler, placement);
+        ok = bench.run(rec);
+    } else {
+        throw std::invalid_argument("Unknown workload " + workload + ", expected bank or list");
+    }
+
+    // baseline: what the machine draws with nothing running
+    long idleMs = cfg.getInt("idlems");
+    if (idleMs > 0) {
+        sampler.beginPhase("idle");
+        std::this_thread::sleep_for(std::chrono::milliseconds(idleMs));
+        sampler.endPhase();
+    }
+    sampler.stop();
+
+    rec.add("baseline_w", sampler.baselineWatts());
+    for (const EnergySampler::Phase& p : sampler.phases()) {
+        double net = sampler.netEnergy(p);
+        printf("Phase %s: %lf seconds, %lf Joules, %lf Joules above idle\n", p.name.c_str(), p.duration(),
+               p.energy[PACKAGE], net);
+        rec.add(p.name + "_phase_s", p.duration());
+        for (int d = 0; d < DOMAINS; d++) {
+            if (meter.available(d)) {
+                rec.add(p.name + "_" + EnergyMeter::domainName(d) + "_j", p.energy[d]);
+            }
+        }
+        if (p.name != "idle") {
+            rec.add(p.name + "_net_j", net);
+            rec.add(p.name + "_net_j_per_op", p.ops > 0 ? net / p.ops : 0.0);
+        }
+    }
+    std::string sampleFile = cfg.getString("samplefile");
+    if (!sampleFile.empty() && !sampler.writeSamples(sampleFile)) {
+        std::cerr << "Cannot write " << sampleFile << std::endl;
+    }
+    return ok;
+}
+
+// Runs the workload named in cfg and fills rec with the settings it ran under
+// followed by its measurements. With migrate=compare the workload runs twice,
+// statically placed and then migrating, and the record holds the migrating
+// run plus what it gained over the static one (positive is better).
+// Throws std::invalid_argument on a bad config.
+inline bool runBenchmark(const Config& cfg, Record& rec) {
+    for (const auto& kv : cfg.all()) {
+        rec.add(kv.first, kv.second);
+    }
+    bool ok;
+    if (cfg.getString("migrate") == "compare") {
+        Config staticCfg = cfg;
+        staticCfg.set("migrate", "0");
+        Record staticRec;
+        std::cout << "Static placement run" << std::endl;
+        bool staticOk = runWorkload(staticCfg, staticRec);
+        Config migrateCfg = cfg;
+        migrateCfg.set("migrate", "1");
+        std::cout << "Migrating run" << std::endl;
+        ok = runWorkload(migrateCfg, rec) && staticOk;
+        double timeGain = staticRec.number("parallel_phase_s") - rec.number("parallel_phase_s");
+        double energyGain = staticRec.number("parallel_net_j") - rec.number("parallel_net_j");
+        rec.add("static_parallel_phase_s", staticRec.number("parallel_phase_s"));
+        rec.add("static_parallel_net_j", staticRec.number("parallel_net_j"));
+        rec.add("migration_time_gain_s", timeGain);
+        rec.add("migration_energy_gain_j", energyGain);
+        printf("Migration gained %lf seconds and %lf Joules over static placement\n", timeGain, energyGain);
+    } else {
+        ok = runWorkload(cfg, rec);
+    }
+    rec.add("ok", ok);
+    return ok;
+}
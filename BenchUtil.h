@@ -0,0 +1,127 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+
+// Helpers shared by the bank and list workloads
+
+// xoshiro256** generator, a few cycles per number with no distribution
+// object to build per call. Each thread owns one (threadRandom()), seeded from
+// random_device on first use unless seedThreadRandom() gave it a fixed stream.
+class FastRandom {
+public:
+    FastRandom();
+    void seed(uint64_t seed, uint64_t stream);
+    uint64_t next();
+    uint32_t next32();
+    uint32_t below(uint32_t range);
+
+private:
+    uint64_t s[4];
+
+    static uint64_t splitmix(uint64_t& x);
+    static uint64_t rotl(uint64_t x, int k);
+};
+
+inline uint64_t FastRandom::splitmix(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+inline uint64_t FastRandom::rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+inline FastRandom::FastRandom() {
+    std::random_device rd;
+    seed(((uint64_t)rd() << 32) | rd(), 0);
+}
+
+// Same seed and stream, same sequence
+inline void FastRandom::seed(uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ (stream * 0xd1b54a32d192ed03ULL);
+    for (int i = 0; i < 4; i++) {
+        s[i] = splitmix(x);
+    }
+}
+
+inline uint64_t FastRandom::next() {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+inline uint32_t FastRandom::next32() {
+    return (uint32_t)(next() >> 32);
+}
+
+// Uniform in [0, range) without division in the common case (Lemire)
+inline uint32_t FastRandom::below(uint32_t range) {
+    uint64_t m = (uint64_t)next32() * range;
+    uint32_t low = (uint32_t)m;
+    if (low < range) {
+        uint32_t threshold = -range % range;
+        while (low < threshold) {
+            m = (uint64_t)next32() * range;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+inline FastRandom& threadRandom() {
+    thread_local FastRandom gen;
+    return gen;
+}
+
+// Fixes the calling thread's sequence, e.g. to (run seed, thread number)
+inline void seedThreadRandom(uint64_t seed, uint64_t stream) {
+    threadRandom().seed(seed, stream);
+}
+
+// Generates a random int between min and max (inclusive)
+inline int generateRandomInt(int min, int max) {
+    return min + (int)threadRandom().below((uint32_t)((int64_t)max - min + 1));
+}
+
+// Maps a uniform 32-bit draw onto [0, max], so a random amount can be drawn
+// before the balance it depends on is known (outside the account locks)
+inline long long scaleFraction(uint32_t fraction, long long max) {
+    return (long long)(((unsigned __int128)fraction * (unsigned long long)(max + 1)) >> 32);
+}
+
+// Pins handle to a single CPU; warns instead of silently ignoring a bad id
+inline bool pinThread(pthread_t handle, int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        std::cerr << "Cannot pin to CPU " << cpu << std::endl;
+        return false;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    int rc = pthread_setaffinity_np(handle, sizeof(cpu_set_t), &cpuset);
+    if (rc != 0) {
+        std::cerr << "Cannot pin to CPU " << cpu << " (error " << rc << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// What every worker reports back when it finishes
+struct ThreadStats {
+    double time = 0.0; // seconds
+    long ops = 0;
+    double latencyNs = 0.0; // mean over sampled operations
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <pthread.h>
+#include "Ledger.h"
+#include "Locks.h"
+
+// Delegation executor. Every worker owns one padded request slot; instead of
+// taking the account locks itself it publishes a transfer there and waits.
+// Combiner threads sweep their share of the slots (slot % combiners) and
+// apply everything pending in one pass, so the ledger and its locks stay in
+// the combiners' caches instead of bouncing between every worker's core.
+class Combiner {
+public:
+    // apply(slot, transfer) runs on a combiner thread; slot is the worker index
+    typedef std::function<void(int, Transfer&)> ApplyFn;
+
+    Combiner(int _slots);
+    ~Combiner();
+    void start(int _combiners, ApplyFn _apply);
+    void stop();
+    long submit(int slot, int from, int to, long long amt);
+    pthread_t handle(int combiner);
+    long applied();
+    long sweeps();
+
+private:
+    static const int EMPTY = 0;
+    static const int POSTED = 1;
+    static const int DONE = 2;
+    static const int IDLESPINS = 256;
+
+    struct alignas(64) Slot {
+        std::atomic<int> state{EMPTY};
+        Transfer request;
+    };
+    struct alignas(64) Stats {
+        long applied = 0;
+        long sweeps = 0;
+    };
+
+    int slots;
+    int combiners;
+    std::vector<Slot> requests;
+    std::vector<Stats> stats;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping;
+    ApplyFn apply;
+
+    void combine(int c);
+};
+
+inline Combiner::Combiner(int _slots) : requests(_slots) {
+    slots = _slots;
+    combiners = 0;
+    stopping = false;
+}
+
+inline Combiner::~Combiner() {
+    stop();
+}
+
+inline void Combiner::start(int _combiners, ApplyFn _apply) {
+    stop();
+    combiners = _combiners;
+    apply = _apply;
+    stopping = false;
+    stats.assign(combiners, Stats());
+    for (int c = 0; c < combiners; c++) {
+        threads.emplace_back(&Combiner::combine, this, c);
+    }
+}
+
+inline void Combiner::stop() {
+    stopping = true;
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    threads.clear();
+}
+
+inline pthread_t Combiner::handle(int combiner) {
+    return threads[combiner].native_handle();
+}
+
+// Publishes the transfer and waits for a combiner to apply it. amt reaches
+// apply() as given. Returns the time from publishing to completion in
+// nanoseconds.
+inline long Combiner::submit(int slot, int from, int to, long long amt) {
+    auto start = std::chrono::steady_clock::now();
+    Slot& s = requests[slot];
+    s.request.from = from;
+    s.request.to = to;
+    s.request.amt = amt;
+    s.state.store(POSTED, std::memory_order_release);
+    for (int i = 0; s.state.load(std::memory_order_acquire) != DONE; i++) {
+        if (i < IDLESPINS) {
+            cpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    s.state.store(EMPTY, std::memory_order_relaxed);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void Combiner::combine(int c) {
+    int idle = 0;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        int found = 0;
+        for (int i = c; i < slots; i += combiners) {
+            Slot& s = requests[i];
+            if (s.state.load(std::memory_order_acquire) == POSTED) {
+                apply(i, s.request);
+                s.state.store(DONE, std::memory_order_release);
+                found++;
+            }
+        }
+        stats[c].applied += found;
+        stats[c].sweeps++;
+        if (found > 0) {
+            idle = 0;
+        } else if (++idle < IDLESPINS) {
+            cpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Only meaningful after stop()
+inline long Combiner::applied() {
+    long total = 0;
+    for (const Stats& s : stats) {
+        total += s.applied;
+    }
+    return total;
+}
+
+inline long Combiner::sweeps() {
+    long total = 0;
+    for (const Stats& s : stats) {
+        total += s.sweeps;
+    }
+    return total;
+}
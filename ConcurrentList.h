@@ -8,57 +8,299 @@
 #include <mutex>
 #include <shared_mutex>
 #include <memory>
+#include <atomic>
+#include <climits>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
 
+#include "Locks.h"
+#include "LockProfile.h"
+#include "ScanPool.h"
+#include "Search.h"
+#include "ValueIndex.h"
+
+// Set when built with -fsanitize=thread: seqlock scans then use relaxed
+// atomic loads instead of the vector kernels, which TSan would report
+#if defined(__SANITIZE_THREAD__)
+#define LIST_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define LIST_TSAN 1
+#endif
+#endif
+
+// Striped list on a segmented store. Segment k holds firstSegment << k
+// elements and the stripe locks covering them, and the directory of segments
+// never moves, so growing only publishes a new segment: elements stay where
+// they are and readers never wait for an append. add() reserves a slot with
+// one atomic compare-and-swap; slots become visible to get/set/contains in
+// reservation order once written, and a failed append still publishes its
+// slot so it cannot hold up the ones behind it.
+//
+// Stripes are read under their shared_mutex, or in seqlock mode
+// optimistically: a writer holds the stripe's mutex exclusively and bumps the
+// stripe's version to odd before the write and back to even after it, and a
+// reader reads without writing anything, then retries if the version was odd
+// or has moved. Readers never write a shared cache line, so read-mostly
+// traffic stays in each core's cache. In this mode writers store elements and
+// get() loads them with relaxed atomics, so a torn single element is never
+// seen. Scans keep the plain vector loads of the search kernels, racing with
+// the relaxed stores: a deliberate, formally undefined race whose result is
+// thrown away when the version check fails. A ThreadSanitizer build
+// (LIST_TSAN) scans with relaxed atomic loads instead so the mode can be
+// checked, at scalar speed.
+//
+// With indexValues() the list also keeps a ValueIndex of how often each value
+// is stored, and contains() and count() become a lookup in it instead of a
+// scan. set() updates the index inside the stripe's exclusive section, adding
+// the new value before removing the old one, so a value being moved is never
+// briefly missing, and a reader holding the stripe always finds the index
+// agreeing with the stripe. add() counts its value just before publishing it.
 template <typename T>
 class ConcurrentList {
 public:
     ConcurrentList();
-    ConcurrentList(int _size);
+    ConcurrentList(int _size, bool _optimistic = false);
+    ~ConcurrentList();
+    ConcurrentList(const ConcurrentList&) = delete;
+    ConcurrentList& operator=(const ConcurrentList&) = delete;
     bool set(int index, T value);
     T get(int index);
     int size();
     bool contains(T value);
+    bool contains(T value, ScanPool& pool);
+    int indexOf(T value);
+    int count(T value);
     void display();
     void add(T value);
+    int stripes();
+    int segments();
+    void profile(LockStats* _stripeStats);
+    bool optimistic() const;
+    long retries() const;
+    void indexValues(int shards);
+    ValueIndex<T>* valueIndex();
 
 private:
-    int maxSize;
-    int stripeFactor;
-    std::vector<T> data;
-    std::vector<std::shared_ptr<std::shared_mutex>> locks;
-    std::mutex add_mutex;
+    static const int MAXSEGMENTS = 32; // enough to reach INT_MAX from any first segment
+    static const int APPENDSPINS = 1024; // pauses before a waiting append starts yielding
+
+    struct alignas(64) StripeVersion {
+        std::atomic<unsigned> value{0}; // odd while a writer is in the stripe
+    };
 
+    struct Segment {
+        Segment(long length, int stripeFactor)
+            : data(new T[length]()), locks(new std::shared_mutex[length / stripeFactor]),
+              versions(new StripeVersion[length / stripeFactor]) {}
+        std::unique_ptr<T[]> data;
+        std::unique_ptr<std::shared_mutex[]> locks; // one per stripe of the segment
+        std::unique_ptr<StripeVersion[]> versions; // one per stripe, seqlock mode only
+    };
 
-    void resize(int newSize);
+    int stripeFactor;
+    long firstSegment; // a power of two and a multiple of stripeFactor
+    int firstShift;
+    std::atomic<Segment*> directory[MAXSEGMENTS];
+    std::atomic<long> reserved; // slots handed out, written or not
+    std::atomic<long> published; // slots readable; a prefix of reserved
+    LockStats* stripeStats = nullptr; // one per stripe at the time profile() was called
+    int profiledStripes = 0;
+    bool seqlock;
+    std::atomic<long> failedReads{0}; // optimistic reads retried
+    std::unique_ptr<ValueIndex<T>> index; // value -> count when indexValues() was called
+
+    void init(int size);
+    long segmentStart(int k) const;
+    int segmentOf(long index, long& offset) const;
+    Segment* segment(int k);
+    void awaitTurn(long slot);
+    template <typename F>
+    auto readStripe(Segment* s, long offset, int stripe, F read) -> decltype(read());
+    void writeStripe(Segment* s, long offset, int stripe, T value);
+    static T loadRelaxed(const T* p);
+    static void storeRelaxed(T* p, T value);
+    static long searchRelaxed(const T* data, long n, T value, bool countAll);
+    long scanStripes(T value, long n, int first, int last, const std::atomic<bool>* cancelled, bool countAll);
 };
 
 template <typename T>
-ConcurrentList<T>::ConcurrentList() {
-    maxSize = 16;
-    stripeFactor = 1024;
-    data.resize(maxSize);
-    locks.resize(maxSize / stripeFactor);
-    for(int i = 0; i < maxSize / stripeFactor; i++){
-        locks[i] = std::make_shared<std::shared_mutex>();
+ConcurrentList<T>::ConcurrentList() : seqlock(false) {
+    init(16);
+}
+
+template <typename T>
+ConcurrentList<T>::ConcurrentList(int _size, bool _optimistic) : seqlock(_optimistic) {
+    init(_size);
+}
+
+template <typename T>
+ConcurrentList<T>::~ConcurrentList() {
+    for (int k = 0; k < MAXSEGMENTS; k++) {
+        delete directory[k].load();
     }
 }
 
+// The first segment holds the initial elements, all T()
 template <typename T>
-ConcurrentList<T>::ConcurrentList(int _size) {
-    maxSize = _size;
+void ConcurrentList<T>::init(int size) {
+    if (size < 0) {
+        throw std::invalid_argument("Size cannot be negative");
+    }
     stripeFactor = 1024;
-    data.resize(maxSize);
-    locks.resize(maxSize / stripeFactor);
-    for(int i = 0; i < maxSize / stripeFactor; i++){
-        locks[i] = std::make_shared<std::shared_mutex>();
+    firstSegment = stripeFactor;
+    while (firstSegment < size) {
+        firstSegment <<= 1;
+    }
+    firstShift = __builtin_ctzl(firstSegment);
+    for (int k = 0; k < MAXSEGMENTS; k++) {
+        directory[k].store(nullptr);
+    }
+    directory[0].store(new Segment(firstSegment, stripeFactor));
+    reserved.store(size);
+    published.store(size);
+}
+
+template <typename T>
+long ConcurrentList<T>::segmentStart(int k) const {
+    return firstSegment * ((1L << k) - 1);
+}
+
+// Segment holding index, and index's offset into it
+template <typename T>
+int ConcurrentList<T>::segmentOf(long index, long& offset) const {
+    int k = 63 - __builtin_clzll((unsigned long long)(index >> firstShift) + 1);
+    offset = index - segmentStart(k);
+    return k;
+}
+
+// Segment k, allocated by whichever appender reaches it first
+template <typename T>
+typename ConcurrentList<T>::Segment* ConcurrentList<T>::segment(int k) {
+    Segment* s = directory[k].load(std::memory_order_acquire);
+    if (s == nullptr) {
+        Segment* fresh = new Segment(firstSegment << k, stripeFactor);
+        if (directory[k].compare_exchange_strong(s, fresh, std::memory_order_acq_rel)) {
+            s = fresh;
+        } else {
+            delete fresh;
+        }
+    }
+    return s;
+}
+
+// Runs read() on the stripe holding offset under the stripe's shared lock,
+// or in seqlock mode optimistically until no writer overlapped it
+template <typename T>
+template <typename F>
+auto ConcurrentList<T>::readStripe(Segment* s, long offset, int stripe, F read) -> decltype(read()) {
+    int local = offset / stripeFactor;
+    if (seqlock) {
+        std::atomic<unsigned>& version = s->versions[local].value;
+        while (true) {
+            unsigned before = version.load(std::memory_order_acquire);
+            if ((before & 1) == 0) {
+                auto result = read();
+                std::atomic_thread_fence(std::memory_order_acquire); // the reads complete before the recheck
+                if (version.load(std::memory_order_relaxed) == before) {
+                    return result;
+                }
+            }
+            failedReads.fetch_add(1, std::memory_order_relaxed);
+            cpuRelax();
+        }
+    }
+    std::shared_mutex& lock = s->locks[local];
+    if (stripe < profiledStripes) {
+        long since = profiledLockShared(lock, stripeStats[stripe]);
+        auto result = read();
+        profiledUnlockShared(lock, stripeStats[stripe], since);
+        return result;
+    }
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return read();
+}
+
+// Writers exclude each other with the stripe's mutex in either mode
+template <typename T>
+void ConcurrentList<T>::writeStripe(Segment* s, long offset, int stripe, T value) {
+    int local = offset / stripeFactor;
+    std::shared_mutex& lock = s->locks[local];
+    bool profiled = stripe < profiledStripes;
+    if (profiled) {
+        profiledLock(lock, stripeStats[stripe]);
+    } else {
+        lock.lock();
+    }
+    if (index && !(s->data[offset] == value)) {
+        index->add(value, 1);
+        index->add(s->data[offset], -1);
+    }
+    if (seqlock) {
+        std::atomic<unsigned>& version = s->versions[local].value;
+        unsigned v = version.load(std::memory_order_relaxed);
+        version.store(v + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release); // odd is visible before the data changes
+        storeRelaxed(&s->data[offset], value);
+        version.store(v + 2, std::memory_order_release);
+    } else {
+        s->data[offset] = value;
+    }
+    if (profiled) {
+        profiledUnlock(lock, stripeStats[stripe]);
+    } else {
+        lock.unlock();
+    }
+}
+
+// Element accesses that may overlap in seqlock mode. Types the compiler can
+// load and store in one instruction use relaxed atomics; others fall back to
+// plain copies.
+template <typename T>
+T ConcurrentList<T>::loadRelaxed(const T* p) {
+    if constexpr (std::is_trivially_copyable<T>::value &&
+                  (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)) {
+        T value;
+        __atomic_load(p, &value, __ATOMIC_RELAXED);
+        return value;
+    } else {
+        return *p;
+    }
+}
+
+template <typename T>
+void ConcurrentList<T>::storeRelaxed(T* p, T value) {
+    if constexpr (std::is_trivially_copyable<T>::value &&
+                  (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)) {
+        __atomic_store(p, &value, __ATOMIC_RELAXED);
+    } else {
+        *p = value;
+    }
+}
+
+// searchScalar() over relaxed atomic loads, for seqlock scans under TSan
+template <typename T>
+long ConcurrentList<T>::searchRelaxed(const T* data, long n, T value, bool countAll) {
+    long found = 0;
+    for (long i = 0; i < n; i++) {
+        if (loadRelaxed(data + i) == value) {
+            if (!countAll) {
+                return i;
+            }
+            found++;
+        }
     }
+    return countAll ? found : -1;
 }
 
 template <typename T>
 bool ConcurrentList<T>::set(int index, T value) {
-    if (index >= 0 && index < maxSize) {
-        std::unique_lock<std::shared_mutex> lock(*(locks[index/stripeFactor]));
-        data[index] = value;
+    if (index >= 0 && index < published.load(std::memory_order_acquire)) {
+        long offset;
+        Segment* s = directory[segmentOf(index, offset)].load(std::memory_order_acquire);
+        writeStripe(s, offset, index/stripeFactor, value);
         return true;
     }
     return false;
@@ -66,75 +308,233 @@ bool ConcurrentList<T>::set(int index, T value) {
 
 template <typename T>
 T ConcurrentList<T>::get(int index) {
-    if (index >= 0 && index < maxSize) {
-        std::shared_lock<std::shared_mutex> lock(*(locks[index/stripeFactor]));
-        return data[index];
+    if (index >= 0 && index < published.load(std::memory_order_acquire)) {
+        long offset;
+        Segment* s = directory[segmentOf(index, offset)].load(std::memory_order_acquire);
+        const T* data = s->data.get();
+        if (seqlock) {
+            return readStripe(s, offset, index/stripeFactor, [data, offset] { return loadRelaxed(data + offset); });
+        }
+        return readStripe(s, offset, index/stripeFactor, [data, offset] { return data[offset]; });
     }
     throw std::out_of_range("Index out of range");
 }
 
 template <typename T>
 int ConcurrentList<T>::size() {
-    return maxSize;
+    return published.load(std::memory_order_acquire);
 }
 
+// Scans stripes [first, last) of the first n elements one stripe at a time,
+// with the search kernel running inside readStripe(). Returns the
+// index of the first match or -1, or with countAll the number of matches.
+// Stops early once cancelled is set.
 template <typename T>
-bool ConcurrentList<T>::contains(T value) {
-    for (int stripe = 0; stripe < locks.size(); stripe++) {
-        std::shared_lock<std::shared_mutex> lock(*locks[stripe]);
-        int end = (stripe * stripeFactor + stripeFactor < data.size()) ? (stripe * stripeFactor + stripeFactor) : data.size();
-        for (int i = stripe * stripeFactor; i < end; ++i) {
-            if (data[i] == value) {
-                return true;
-            }
+long ConcurrentList<T>::scanStripes(T value, long n, int first, int last, const std::atomic<bool>* cancelled,
+                                    bool countAll) {
+#ifdef LIST_TSAN
+    const bool relaxedScans = true;
+#else
+    const bool relaxedScans = false;
+#endif
+    long matches = 0;
+    for (int stripe = first; stripe < last; stripe++) {
+        if (cancelled != nullptr && cancelled->load(std::memory_order_relaxed)) {
+            return -1;
+        }
+        long start = (long)stripe * stripeFactor;
+        long offset;
+        Segment* s = directory[segmentOf(start, offset)].load(std::memory_order_acquire);
+        const T* data = s->data.get() + offset;
+        long length = std::min((long)stripeFactor, n - start);
+        long found;
+        if (seqlock && relaxedScans) {
+            found = readStripe(s, offset, stripe,
+                               [data, length, value, countAll] { return searchRelaxed(data, length, value, countAll); });
+        } else {
+            found = readStripe(s, offset, stripe, [data, length, value, countAll] {
+                return countAll ? searchCount(data, length, value) : searchIndex(data, length, value);
+            });
+        }
+        if (countAll) {
+            matches += found;
+        } else if (found >= 0) {
+            return start + found;
         }
     }
-    
-    return false;
+    return countAll ? matches : -1;
 }
 
+// Scans the elements published when the call started, one stripe at a time,
+// or with the value index looks value up
 template <typename T>
-void ConcurrentList<T>::display() {
-    for (const auto& elem : data) {
-        std::cout << elem << " ";
+bool ConcurrentList<T>::contains(T value) {
+    if (index) {
+        return index->count(value) > 0;
     }
-    std::cout << std::endl;
+    long n = published.load(std::memory_order_acquire);
+    return scanStripes(value, n, 0, (n + stripeFactor - 1) / stripeFactor, nullptr, false) >= 0;
 }
 
+// The same scan split into contiguous stripe ranges across pool, one range
+// per part, each part taking only its own stripes' locks. A match anywhere
+// cancels the other parts.
 template <typename T>
-void ConcurrentList<T>::resize(int newSize) {
-    if (newSize < 0) {
-        throw std::invalid_argument("New size cannot be negative");
+bool ConcurrentList<T>::contains(T value, ScanPool& pool) {
+    if (index) {
+        return index->count(value) > 0;
+    }
+    long n = published.load(std::memory_order_acquire);
+    int total = (n + stripeFactor - 1) / stripeFactor;
+    int parts = std::min(total, (pool.workers() + 1) * 4); // a few per thread evens out uneven progress
+    if (parts <= 1) {
+        return scanStripes(value, n, 0, total, nullptr, false) >= 0;
     }
+    return pool.any(parts, [this, value, n, total, parts](int part, const std::atomic<bool>& cancelled) {
+        return scanStripes(value, n, (long)total * part / parts, (long)total * (part + 1) / parts, &cancelled,
+                           false) >= 0;
+    });
+}
 
-    std::vector<std::unique_lock<std::shared_mutex>> heldLocks;
-    for (int i = 0; i < maxSize/stripeFactor; ++i) {
-        heldLocks.emplace_back(*locks[i]);
+// First index holding value, -1 if none. Stripes are locked one at a time,
+// so against concurrent writers this is a match that existed during the
+// scan, not necessarily the first at any one instant.
+template <typename T>
+int ConcurrentList<T>::indexOf(T value) {
+    long n = published.load(std::memory_order_acquire);
+    return scanStripes(value, n, 0, (n + stripeFactor - 1) / stripeFactor, nullptr, false);
+}
+
+// Elements equal to value, from the value index or counted stripe by stripe
+template <typename T>
+int ConcurrentList<T>::count(T value) {
+    if (index) {
+        return index->count(value);
     }
+    long n = published.load(std::memory_order_acquire);
+    return scanStripes(value, n, 0, (n + stripeFactor - 1) / stripeFactor, nullptr, true);
+}
 
-    data.resize(newSize);
+// stripes holding published elements
+template <typename T>
+int ConcurrentList<T>::stripes() {
+    return (size() + stripeFactor - 1) / stripeFactor;
+}
 
-    if (newSize > maxSize) {
-        locks.resize(newSize/stripeFactor);
-        for (int i = maxSize/stripeFactor; i < newSize; ++i) {
-            locks[i] = std::make_shared<std::shared_mutex>();
-        }
-    } else {
-        locks.resize(newSize/stripeFactor); // safely shrink locks
+template <typename T>
+int ConcurrentList<T>::segments() {
+    int n = 0;
+    while (n < MAXSEGMENTS && directory[n].load(std::memory_order_acquire) != nullptr) {
+        n++;
     }
+    return n;
+}
 
-    maxSize = newSize;
+// Times every stripe lock from now on into _stripeStats, which needs one
+// entry per stripe; stripes added by later appends stay unprofiled
+template <typename T>
+void ConcurrentList<T>::profile(LockStats* _stripeStats) {
+    stripeStats = _stripeStats;
+    profiledStripes = _stripeStats != nullptr ? stripes() : 0;
 }
 
+template <typename T>
+bool ConcurrentList<T>::optimistic() const {
+    return seqlock;
+}
 
+// optimistic stripe reads that overlapped a writer and ran again
+template <typename T>
+long ConcurrentList<T>::retries() const {
+    return failedReads.load();
+}
+
+// Builds the value index from the current elements. Call it before other
+// threads use the list; from then on every write keeps the index current.
+template <typename T>
+void ConcurrentList<T>::indexValues(int shards) {
+    std::unordered_map<T, long> counts;
+    int n = size();
+    for (int i = 0; i < n; i++) {
+        counts[get(i)]++;
+    }
+    std::unique_ptr<ValueIndex<T>> built(new ValueIndex<T>(shards));
+    for (const auto& c : counts) {
+        built->add(c.first, c.second);
+    }
+    index = std::move(built);
+}
+
+// null unless indexValues() was called
+template <typename T>
+ValueIndex<T>* ConcurrentList<T>::valueIndex() {
+    return index.get();
+}
+
+template <typename T>
+void ConcurrentList<T>::display() {
+    int n = size();
+    for (int i = 0; i < n; i++) {
+        std::cout << get(i) << " ";
+    }
+    std::cout << std::endl;
+}
+
+// The slot is written before it is published, so nothing else can be
+// touching it and no stripe lock is needed. Publication follows reservation
+// order, which keeps published a prefix of the written slots. The slot's
+// segment is allocated before the slot is reserved, so running out of memory
+// there reserves nothing. If writing the value or counting it in the index
+// throws, the slot is left holding T(), not counted in the index, and still
+// published before the exception propagates, so later appends never wait on
+// it.
 template <typename T>
 void ConcurrentList<T>::add(T value) {
-    std::lock_guard<std::mutex> lock(add_mutex);
-    if (data.size() < maxSize) {
-        data.push_back(value);
-    } else {
-        resize(maxSize * 2);
-        maxSize *= 2;
-        data.push_back(value);
+    long slot = reserved.load(std::memory_order_relaxed);
+    long offset;
+    Segment* s;
+    do {
+        if (slot >= INT_MAX) {
+            throw std::length_error("ConcurrentList is full");
+        }
+        s = segment(segmentOf(slot, offset));
+    } while (!reserved.compare_exchange_weak(slot, slot + 1, std::memory_order_relaxed));
+    std::exception_ptr failed;
+    try {
+        s->data[offset] = value;
+    } catch (...) {
+        failed = std::current_exception();
+    }
+    awaitTurn(slot);
+    if (!failed && index) {
+        try {
+            index->add(value, 1);
+        } catch (...) {
+            failed = std::current_exception();
+        }
+    }
+    if (failed) {
+        s->data[offset] = T();
+    }
+    published.store(slot + 1, std::memory_order_release);
+    if (failed) {
+        std::rethrow_exception(failed);
     }
-}
\ No newline at end of file
+}
+
+// Waits until every slot before slot is published: a short spin, since the
+// appender ahead is normally mid-store, then yielding. Every append publishes
+// its slot, failed or not, so this only waits as long as the appenders ahead
+// are descheduled.
+template <typename T>
+void ConcurrentList<T>::awaitTurn(long slot) {
+    for (int spin = 0; spin < APPENDSPINS; spin++) {
+        if (published.load(std::memory_order_acquire) == slot) {
+            return;
+        }
+        cpuRelax();
+    }
+    while (published.load(std::memory_order_acquire) != slot) {
+        std::this_thread::yield();
+    }
+}
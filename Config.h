@@ -0,0 +1,263 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+// Run time benchmark configuration. Every knob that used to be a #define in
+// bank.cpp / bank2.cpp / bank3.cpp / test.cpp is a key=value setting with the
+// old value as its default. Settings come from the command line
+// (./bench threads=16 lock=mcs) and/or a file (./bench config=run.cfg) holding
+// one key=value per line with # comments; later settings override earlier ones.
+class Config {
+public:
+    Config();
+    bool parse(int argc, char** argv);
+    bool parseFile(const std::string& path);
+    bool set(const std::string& key, const std::string& value);
+    void fallback(const std::string& key, const std::string& value);
+    void workloadDefaults();
+    bool has(const std::string& key) const;
+    std::string getString(const std::string& key) const;
+    long getInt(const std::string& key) const;
+    double getDouble(const std::string& key) const;
+    const std::map<std::string, std::string>& all() const;
+    void usage(std::ostream& out) const;
+
+private:
+    struct Setting {
+        std::string value;
+        std::string help;
+        bool given;
+    };
+    std::map<std::string, Setting> settings;
+    std::vector<std::string> order; // keys in declaration order, for usage()
+    std::map<std::string, std::string> values;
+
+    void define(const std::string& key, const std::string& value, const std::string& help);
+};
+
+inline Config::Config() {
+    define("workload", "bank", "bank (account transfers) or list (ConcurrentList contains/set/get)");
+    define("mode", "queue", "bank: queue (audits handed to balance threads), mixed (every thread audits inline), split (dedicated deposit and balance threads)");
+    define("threads", "28", "total worker threads");
+    define("iterations", "", "total operations; defaults to 2000000 for bank, 5000000 for list");
+    define("placement", "split", "split (readers and combiners on the fastest CPUs, writers on the slowest), spread, compact, smtpair or none");
+    define("migrate", "0", "bank: move lock holders to the fastest class and waiters off it while running (1), or compare (run static, then migrating, and report the gain)");
+    define("migratems", "20", "bank: ms between migration decisions");
+    define("promote", "0.1", "bank: hold minus wait fraction above which a thread moves to a fast core");
+    define("demote", "-0.1", "bank: hold minus wait fraction below which a thread leaves a fast core");
+    define("dwell", "3", "bank: intervals a migrated thread stays put");
+    define("governor", "off", "bank: park writer threads at run time to reach throughput (most ops/s under powercap) or energy (fewest J/op above minthroughput)");
+    define("powercap", "0", "bank: governor=throughput package power limit in watts, 0 for none");
+    define("minthroughput", "0", "bank: governor=energy lowest acceptable ops/s");
+    define("governms", "100", "bank: ms between governor adjustments");
+    define("minthreads", "1", "bank: fewest writer threads the governor keeps running");
+    define("seed", "0", "per-thread random seed, so thread n draws the same operations every run; 0 seeds randomly");
+    define("trace", "", "binary operation trace the writers replay instead of drawing operations, empty draws them live");
+    define("tracemode", "replay", "replay an existing trace, or record this run's operations to it first and then replay them");
+    define("keydist", "uniform", "keys drawn: uniform, zipf, hotset (hotops of the operations on hotkeys of the keys) or bursty (a hotset that moves every burstms); bank accounts, list indices and values");
+    define("valuedist", "", "list: distribution of the values set and searched for, empty uses keydist");
+    define("zipftheta", "0.99", "keydist=zipf skew, between 0 and 1");
+    define("hotkeys", "0.1", "fraction of the keys in the hot set; results are split into hot and cold keys");
+    define("hotops", "0.9", "hotset and bursty: fraction of the operations on hot keys");
+    define("burstms", "100", "bursty: ms before the hot set moves");
+    define("rate", "0", "open loop: operations/s offered across all issuing threads, 0 runs closed loop");
+    define("arrival", "poisson", "open loop interarrival times: constant or poisson");
+    define("lockprofile", "0", "1 times every lock acquisition and hold and reports the hottest locks");
+    define("locktop", "10", "hottest locks listed in the lock profile report");
+    define("lockprofilefile", "", "CSV the per-lock counts and wait/hold histograms are written to, empty skips it");
+    define("cpuroot", "/sys/devices/system/cpu", "sysfs directory the CPU topology and frequencies are read from");
+    define("freqcaps", "", "per-CPU max frequency for the run, e.g. 0-25:1200000/26-27:4200000 (kHz, min or max); restored afterwards");
+    define("dvfsjournal", ".dvfs-restore", "file holding the original frequencies while capped, replayed if a run was killed");
+    define("sequential", "", "also run the single-threaded comparison (1/0); defaults to 1 for bank, 0 for list");
+    define("idlems", "334", "length of the idle baseline measured after the run and subtracted from every phase, 0 skips it");
+    define("sweep", "", "grid to run instead of a single benchmark, e.g. threads=8,16;lock=mutex,mcs (axes split by ;, values by ,)");
+    define("repeat", "3", "sweep: measured runs per grid point");
+    define("warmup", "1", "sweep: unrecorded runs before a point's first measured run");
+    define("sweepseed", "0", "sweep: seed of the randomized run order, 0 picks one");
+    define("sweepout", "Sweep", "sweep: per-point statistics go to <sweepout>.csv and <sweepout>.jsonl");
+    define("results", "Results.jsonl", "file the run record is appended to, one JSON object per line");
+    define("tag", "", "free-form label copied into the record");
+    define("energy", "rapl", "energy counters: rapl, sim (constant simulated power) or none");
+    define("raplroot", "/sys/class/powercap", "powercap sysfs directory holding the intel-rapl zones");
+    define("simidlewatts", "10", "energy=sim: package power with nothing running");
+    define("simcorewatts", "5", "energy=sim: package power added per busy core");
+    define("samplems", "10", "ms between background energy samples, 0 disables the sampler thread");
+    define("samplefile", "", "CSV the energy/CPU time series is written to, empty skips it");
+    // bank
+    define("accounts", "1000", "bank: number of accounts");
+    define("total", "100000", "bank: money in the system, in whole units");
+    define("chance", "95", "bank: percent of operations that are deposits, the rest are audits");
+    define("balancethreads", "3", "bank: threads that only audit");
+    define("audit", "locked", "bank: locked (Ledger), snapshot (SnapshotLedger) or incremental (ShardedLedger)");
+    define("padded", "0", "bank: give every account its own cache line (1/0)");
+    define("shards", "16", "bank: shard count for audit=incremental");
+    define("verifyms", "100", "bank: ms between full recounts for audit=incremental, 0 disables");
+    define("lock", "mutex", "bank: account lock policy");
+    define("batch", "1", "bank: transfers per lock acquisition");
+    define("combiners", "0", "bank: delegation threads applying transfers, 0 means workers lock for themselves");
+    define("latencysample", "16", "bank: time 1 in this many lock-based deposits");
+    define("targetlatencyns", "20000", "bank: adaptive lock acceptable mean contended wait");
+    define("tunems", "50", "bank: adaptive lock ms between spin budget adjustments");
+    define("queuesize", "65536", "pending audit/contains requests before producers wait (power of two)");
+    define("auditbatch", "16", "bank: audit requests a balance thread takes per dequeue");
+    // list
+    define("size", "262144", "list: initial list size");
+    define("containsthreads", "26", "list: threads that only serve contains requests");
+    define("containsper", "90", "list: percent of operations that are contains");
+    define("addsper", "95", "list: contains + set percent, the rest are gets");
+    define("appends", "0", "list: percent of the sets that append a value instead, growing the list");
+    define("scanthreads", "0", "list: pool threads every contains scan is split across (plus the calling thread), 0 scans on the calling thread alone");
+    define("scanprobe", "20", "list: with scanthreads, lookups of a missing value timed serially and split after the run to report the speedup");
+    define("stripemode", "shared", "list: stripe reads take a shared_mutex (shared) or run optimistically against a version counter (seqlock; scans race with writers by design, except in TSan builds)");
+    define("valueindex", "0", "list: keep a value -> count index so contains is a hash lookup instead of a scan (1/0)");
+    define("indexshards", "64", "list: lock shards of the value index");
+    define("search", "auto", "list: search kernel for contains, auto (best the CPU has), avx2, sse2 or scalar");
+    define("containsbatch", "16", "list: values a contains thread takes per dequeue");
+}
+
+inline void Config::define(const std::string& key, const std::string& value, const std::string& help) {
+    settings[key] = Setting{value, help, false};
+    values[key] = value;
+    order.push_back(key);
+}
+
+inline bool Config::set(const std::string& key, const std::string& value) {
+    auto it = settings.find(key);
+    if (it == settings.end()) {
+        std::cerr << "Unknown setting " << key << std::endl;
+        return false;
+    }
+    it->second.value = value;
+    it->second.given = true;
+    values[key] = value;
+    return true;
+}
+
+// Sets key only if the user did not
+inline void Config::fallback(const std::string& key, const std::string& value) {
+    Setting& s = settings.at(key);
+    if (!s.given) {
+        s.value = value;
+        values[key] = value;
+    }
+}
+
+inline bool Config::parseFile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "Cannot open config file " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line = line.substr(0, hash);
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                std::cerr << "Bad config line: " << line << std::endl;
+                return false;
+            }
+            continue;
+        }
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        key.erase(0, key.find_first_not_of(" \t"));
+        key.erase(key.find_last_not_of(" \t\r") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+        if (!set(key, value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool Config::parse(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help" || arg == "help") {
+            usage(std::cout);
+            return false;
+        }
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos) {
+            std::cerr << "Expected key=value, got " << arg << std::endl;
+            return false;
+        }
+        std::string key = arg.substr(0, eq);
+        std::string value = arg.substr(eq + 1);
+        bool ok = key == "config" ? parseFile(value) : set(key, value);
+        if (!ok) {
+            return false;
+        }
+    }
+    workloadDefaults();
+    return true;
+}
+
+// Defaults that depend on the workload, for whatever the user left unset
+inline void Config::workloadDefaults() {
+    bool list = getString("workload") == "list";
+    fallback("iterations", list ? "5000000" : "2000000");
+    fallback("sequential", list ? "0" : "1");
+}
+
+inline bool Config::has(const std::string& key) const {
+    return settings.count(key) > 0;
+}
+
+inline std::string Config::getString(const std::string& key) const {
+    return settings.at(key).value;
+}
+
+// The whole value must parse: "10ms" or "1.5" for an integer setting is an
+// error rather than 10 or 1
+inline long Config::getInt(const std::string& key) const {
+    std::string text = getString(key);
+    size_t used = 0;
+    long value = 0;
+    try {
+        value = std::stol(text, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || text.find_first_not_of(" \t", used) != std::string::npos) {
+        throw std::invalid_argument("Setting " + key + " is not an integer: " + text);
+    }
+    return value;
+}
+
+inline double Config::getDouble(const std::string& key) const {
+    std::string text = getString(key);
+    size_t used = 0;
+    double value = 0;
+    try {
+        value = std::stod(text, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || text.find_first_not_of(" \t", used) != std::string::npos) {
+        throw std::invalid_argument("Setting " + key + " is not a number: " + text);
+    }
+    return value;
+}
+
+inline const std::map<std::string, std::string>& Config::all() const {
+    return values;
+}
+
+inline void Config::usage(std::ostream& out) const {
+    out << "usage: bench [key=value ...] [config=file]" << std::endl;
+    for (const std::string& key : order) {
+        const Setting& s = settings.at(key);
+        out << "  " << key << "=" << s.value << "\t" << s.help << std::endl;
+    }
+}
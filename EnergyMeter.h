@@ -0,0 +1,209 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RAPL_ROOT "/sys/class/powercap"
+
+enum EnergyDomain { PACKAGE = 0, CORE = 1, UNCORE = 2, DRAM = 3, DOMAINS = 4 };
+
+// Cumulative energy counters for the RAPL package, core, uncore and dram
+// domains, summed over every socket. Each counter's energy_uj file is opened
+// once and re-read with pread, and a counter that went backwards is taken to
+// have wrapped at its max_energy_range_uj. That correction only holds if the
+// counter is read at least once per wrap period (about a minute at full load
+// on big parts), so long runs should keep a sampler going.
+//
+// The simulated backend models a constant idle power plus a fixed power per
+// busy core (taken from process CPU time), so the benchmarks produce plausible,
+// load-dependent numbers on machines without RAPL.
+class EnergyMeter {
+public:
+    enum Backend { RAPL, SIMULATED, NONE };
+
+    EnergyMeter(Backend _backend = RAPL, const std::string& root = RAPL_ROOT, double simIdleWatts = 10.0,
+                double simCoreWatts = 5.0);
+    ~EnergyMeter();
+    EnergyMeter(const EnergyMeter&) = delete;
+    EnergyMeter& operator=(const EnergyMeter&) = delete;
+
+    static Backend backendNamed(const std::string& name);
+    static const char* domainName(int domain);
+
+    double read(int domain = PACKAGE); // joules since construction
+    bool available(int domain) const;
+    Backend backend() const;
+
+private:
+    struct Counter {
+        int fd;
+        unsigned long long maxRange; // uj at which the counter wraps
+        unsigned long long last;
+    };
+
+    Backend mode;
+    std::vector<Counter> counters[DOMAINS];
+    unsigned long long total[DOMAINS]; // uj accumulated since construction
+    double idleWatts[DOMAINS]; // simulated backend
+    double coreWatts[DOMAINS];
+    std::chrono::steady_clock::time_point start;
+    double startCpu; // process CPU seconds at construction
+    std::mutex m;
+
+    static bool readCounter(int fd, unsigned long long& value);
+    static std::string readName(const std::string& path);
+    bool open(const std::string& root);
+};
+
+inline EnergyMeter::EnergyMeter(Backend _backend, const std::string& root, double simIdleWatts, double simCoreWatts)
+    : mode(_backend) {
+    start = std::chrono::steady_clock::now();
+    // rough split of a client part's power between the domains
+    static const double idleShare[DOMAINS] = {1.0, 0.3, 0.3, 0.2};
+    static const double coreShare[DOMAINS] = {1.0, 0.8, 0.1, 0.1};
+    for (int d = 0; d < DOMAINS; d++) {
+        total[d] = 0;
+        idleWatts[d] = simIdleWatts * idleShare[d];
+        coreWatts[d] = simCoreWatts * coreShare[d];
+    }
+    if (mode == SIMULATED) {
+        timespec cpu;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+        startCpu = cpu.tv_sec + cpu.tv_nsec / 1e9;
+    } else if (mode == RAPL && !open(root)) {
+        std::cerr << "No readable RAPL counters under " << root << ", energy will read as 0 (use energy=sim to simulate)" << std::endl;
+        mode = NONE;
+    }
+}
+
+inline EnergyMeter::~EnergyMeter() {
+    for (int d = 0; d < DOMAINS; d++) {
+        for (Counter& c : counters[d]) {
+            close(c.fd);
+        }
+    }
+}
+
+inline EnergyMeter::Backend EnergyMeter::backendNamed(const std::string& name) {
+    if (name == "rapl") return RAPL;
+    if (name == "sim") return SIMULATED;
+    if (name == "none") return NONE;
+    throw std::invalid_argument("Unknown energy backend " + name + ", expected rapl, sim or none");
+}
+
+inline const char* EnergyMeter::domainName(int domain) {
+    static const char* names[DOMAINS] = {"package", "core", "uncore", "dram"};
+    return names[domain];
+}
+
+inline bool EnergyMeter::readCounter(int fd, unsigned long long& value) {
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    value = strtoull(buf, nullptr, 10);
+    return true;
+}
+
+inline std::string EnergyMeter::readName(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return "";
+    }
+    char buf[64];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    close(fd);
+    std::string name(buf, n > 0 ? n : 0);
+    while (!name.empty() && (name.back() == '\n' || name.back() == ' ')) {
+        name.pop_back();
+    }
+    return name;
+}
+
+// Zones show up flat under the powercap class as intel-rapl:<socket> (package)
+// and intel-rapl:<socket>:<n> (core, uncore, dram), told apart by their name file
+inline bool EnergyMeter::open(const std::string& root) {
+    DIR* dir = opendir(root.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    bool any = false;
+    while (dirent* entry = readdir(dir)) {
+        std::string zone = entry->d_name;
+        if (zone.compare(0, 11, "intel-rapl:") != 0) {
+            continue;
+        }
+        std::string path = root + "/" + zone;
+        std::string name = readName(path + "/name");
+        int domain;
+        if (name.compare(0, 7, "package") == 0) domain = PACKAGE;
+        else if (name == "core") domain = CORE;
+        else if (name == "uncore") domain = UNCORE;
+        else if (name == "dram") domain = DRAM;
+        else continue; // psys and friends overlap the package
+
+        Counter c;
+        c.fd = ::open((path + "/energy_uj").c_str(), O_RDONLY);
+        if (c.fd < 0) {
+            std::cerr << "Cannot open " << path << "/energy_uj (energy counters usually need root)" << std::endl;
+            continue;
+        }
+        int rangeFd = ::open((path + "/max_energy_range_uj").c_str(), O_RDONLY);
+        if (rangeFd < 0 || !readCounter(rangeFd, c.maxRange) || c.maxRange == 0) {
+            c.maxRange = 0; // unknown, a backwards step is then dropped rather than corrected
+        }
+        if (rangeFd >= 0) {
+            close(rangeFd);
+        }
+        if (!readCounter(c.fd, c.last)) {
+            close(c.fd);
+            continue;
+        }
+        counters[domain].push_back(c);
+        any = true;
+    }
+    closedir(dir);
+    return any;
+}
+
+inline double EnergyMeter::read(int domain) {
+    if (mode == SIMULATED) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        timespec cpu;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+        double busy = cpu.tv_sec + cpu.tv_nsec / 1e9 - startCpu;
+        return idleWatts[domain] * elapsed.count() + coreWatts[domain] * busy;
+    }
+    std::lock_guard<std::mutex> lock(m);
+    for (Counter& c : counters[domain]) {
+        unsigned long long raw;
+        if (!readCounter(c.fd, raw)) {
+            continue;
+        }
+        if (raw >= c.last) {
+            total[domain] += raw - c.last;
+        } else if (c.maxRange > c.last) {
+            total[domain] += c.maxRange - c.last + raw; // wrapped
+        }
+        c.last = raw;
+    }
+    return total[domain] / 1e6;
+}
+
+inline bool EnergyMeter::available(int domain) const {
+    return mode == SIMULATED || !counters[domain].empty();
+}
+
+inline EnergyMeter::Backend EnergyMeter::backend() const {
+    return mode;
+}
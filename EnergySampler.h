@@ -0,0 +1,213 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <condition_variable>
+#include <time.h>
+
+#include "EnergyMeter.h"
+
+// Attributes energy to phases of a run instead of to threads. Workers no
+// longer read the package counter themselves (every thread saw the same
+// package-wide energy, so per-thread numbers overlapped); the run is cut into
+// named phases and each phase gets the counter difference between its begin
+// and end markers. A phase named "idle" sets the baseline power, which
+// netEnergy() subtracts from the others.
+//
+// While started, a background thread also records a timestamped series of
+// every domain plus process CPU time, which keeps the RAPL counters read
+// often enough to catch wraparound and shows how activity moved over the run.
+class EnergySampler {
+public:
+    struct Sample {
+        double time; // seconds since construction
+        double energy[DOMAINS]; // joules since construction
+        double cpuTime; // process CPU seconds, busy cores = d(cpuTime)/d(time)
+    };
+
+    struct Phase {
+        std::string name;
+        double start;
+        double end;
+        double energy[DOMAINS];
+        long ops;
+        double duration() const { return end - start; }
+    };
+
+    EnergySampler(EnergyMeter& _meter);
+    ~EnergySampler();
+
+    void start(std::chrono::milliseconds interval);
+    void stop();
+    void beginPhase(const std::string& name);
+    void endPhase(long ops = 0);
+
+    EnergyMeter& meter();
+    const std::vector<Phase>& phases() const;
+    const Phase* phase(const std::string& name) const;
+    double baselineWatts(int domain = PACKAGE) const;
+    double netEnergy(const Phase& p, int domain = PACKAGE) const;
+    std::vector<Sample> samples();
+    bool writeSamples(const std::string& path);
+
+private:
+    EnergyMeter& energy;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<Phase> done;
+    Phase current;
+    bool inPhase;
+
+    std::thread worker;
+    std::mutex m; // guards series and running
+    std::condition_variable cv;
+    bool running;
+    std::vector<Sample> series;
+
+    double now() const;
+    Sample take();
+    void loop(std::chrono::milliseconds interval);
+};
+
+inline EnergySampler::EnergySampler(EnergyMeter& _meter) : energy(_meter), inPhase(false), running(false) {
+    origin = std::chrono::steady_clock::now();
+}
+
+inline EnergySampler::~EnergySampler() {
+    stop();
+}
+
+inline double EnergySampler::now() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+}
+
+inline EnergySampler::Sample EnergySampler::take() {
+    Sample s;
+    s.time = now();
+    for (int d = 0; d < DOMAINS; d++) {
+        s.energy[d] = energy.read(d);
+    }
+    timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    s.cpuTime = cpu.tv_sec + cpu.tv_nsec / 1e9;
+    return s;
+}
+
+inline void EnergySampler::start(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(m);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = std::thread(&EnergySampler::loop, this, interval);
+}
+
+inline void EnergySampler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        running = false;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+inline void EnergySampler::loop(std::chrono::milliseconds interval) {
+    std::unique_lock<std::mutex> lock(m);
+    while (running) {
+        lock.unlock();
+        Sample s = take();
+        lock.lock();
+        series.push_back(s);
+        cv.wait_for(lock, interval, [this] { return !running; });
+    }
+}
+
+// Phases are sequential and only marked from the controlling thread
+inline void EnergySampler::beginPhase(const std::string& name) {
+    if (inPhase) {
+        throw std::logic_error("Phase " + current.name + " is still open");
+    }
+    inPhase = true;
+    current.name = name;
+    current.ops = 0;
+    for (int d = 0; d < DOMAINS; d++) {
+        current.energy[d] = energy.read(d);
+    }
+    current.start = now();
+}
+
+inline void EnergySampler::endPhase(long ops) {
+    if (!inPhase) {
+        throw std::logic_error("No phase is open");
+    }
+    current.end = now();
+    for (int d = 0; d < DOMAINS; d++) {
+        current.energy[d] = energy.read(d) - current.energy[d];
+    }
+    current.ops = ops;
+    done.push_back(current);
+    inPhase = false;
+}
+
+inline EnergyMeter& EnergySampler::meter() {
+    return energy;
+}
+
+inline const std::vector<EnergySampler::Phase>& EnergySampler::phases() const {
+    return done;
+}
+
+// Last completed phase with this name, nullptr if there is none
+inline const EnergySampler::Phase* EnergySampler::phase(const std::string& name) const {
+    for (auto it = done.rbegin(); it != done.rend(); ++it) {
+        if (it->name == name) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+inline double EnergySampler::baselineWatts(int domain) const {
+    const Phase* idle = phase("idle");
+    if (idle == nullptr || idle->duration() <= 0) {
+        return 0.0;
+    }
+    return idle->energy[domain] / idle->duration();
+}
+
+// Energy above what the machine would have drawn idling for as long
+inline double EnergySampler::netEnergy(const Phase& p, int domain) const {
+    return p.energy[domain] - baselineWatts(domain) * p.duration();
+}
+
+inline std::vector<EnergySampler::Sample> EnergySampler::samples() {
+    std::lock_guard<std::mutex> lock(m);
+    return series;
+}
+
+// CSV: time, one column per domain, cpu time
+inline bool EnergySampler::writeSamples(const std::string& path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        return false;
+    }
+    out << "time_s";
+    for (int d = 0; d < DOMAINS; d++) {
+        out << "," << EnergyMeter::domainName(d) << "_j";
+    }
+    out << ",cpu_s" << std::endl;
+    for (const Sample& s : samples()) {
+        out << s.time;
+        for (int d = 0; d < DOMAINS; d++) {
+            out << "," << s.energy[d];
+        }
+        out << "," << s.cpuTime << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <thread>
+
+// Epoch bookkeeping shared by the snapshot-style ledgers. Writers announce the
+// epoch they commit into; an auditor closes the current epoch and waits for
+// the writers still committing into it. Writers never wait on the auditor.
+class EpochDomain {
+public:
+    EpochDomain(int _threads);
+    unsigned long long enter(int threadNum);
+    void exit(int threadNum);
+    unsigned long long close();
+
+private:
+    // one slot per writer so announcing an epoch does not false-share
+    struct alignas(64) Slot {
+        std::atomic<unsigned long long> epoch;
+    };
+
+    int threads;
+    std::vector<Slot> active; // 0 means the thread is not inside a write
+    std::atomic<unsigned long long> epoch;
+};
+
+inline EpochDomain::EpochDomain(int _threads) : active(_threads) {
+    threads = _threads;
+    for (int i = 0; i < threads; i++) {
+        active[i].epoch.store(0, std::memory_order_relaxed);
+    }
+    epoch.store(1);
+}
+
+// Publish the epoch this write belongs to. The re-check closes the window
+// where an auditor bumps the epoch between our load and our announcement.
+inline unsigned long long EpochDomain::enter(int threadNum) {
+    unsigned long long e = epoch.load();
+    while (true) {
+        active[threadNum].epoch.store(e);
+        unsigned long long now = epoch.load();
+        if (now == e) {
+            return e;
+        }
+        e = now;
+    }
+}
+
+inline void EpochDomain::exit(int threadNum) {
+    active[threadNum].epoch.store(0, std::memory_order_release);
+}
+
+// Returns the epoch that was closed. Callers must serialize close() so that
+// at most one epoch boundary is open at a time.
+inline unsigned long long EpochDomain::close() {
+    unsigned long long snap = epoch.fetch_add(1);
+    for (int t = 0; t < threads; t++) {
+        while (active[t].epoch.load() == snap) {
+            std::this_thread::yield();
+        }
+    }
+    return snap;
+}
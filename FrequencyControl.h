@@ -0,0 +1,279 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Topology.h"
+
+// Caps per-CPU frequencies through cpufreq's scaling_max_freq for the life of
+// the object, replacing cores.sh / restoreSystem.sh. Every file is saved
+// before its first write and put back by restore(), the destructor, exit(),
+// or a fatal signal (SIGINT, SIGTERM, SIGSEGV, ...), after which the signal is
+// re-raised. The original values are also written to a journal file before
+// anything changes; a run that was SIGKILLed leaves it behind and the next
+// FrequencyControl on the same journal restores from it first.
+//
+// Only one instance may be active at a time. The root is configurable so the
+// whole thing can run against a fake directory tree.
+class FrequencyControl {
+public:
+    FrequencyControl(const std::string& _root = CPU_ROOT, const std::string& _journal = "");
+    ~FrequencyControl();
+    FrequencyControl(const FrequencyControl&) = delete;
+    FrequencyControl& operator=(const FrequencyControl&) = delete;
+
+    void cap(int cpu, long khz);
+    void apply(const std::string& spec);
+    void restore();
+    int changed() const;
+
+private:
+    static const int MAXSAVED = 4 * CPU_SETSIZE;
+    static const int PATHLEN = 256;
+
+    // fixed-size so the signal handler can walk it without allocating
+    struct Saved {
+        char path[PATHLEN];
+        char value[32];
+        int length;
+    };
+
+    std::string root;
+    std::string journal;
+    char journalPath[PATHLEN]; // for the signal handler
+    std::unique_ptr<Saved[]> saved;
+    std::atomic<int> count;
+
+    static std::atomic<FrequencyControl*> active;
+    static void onSignal(int sig);
+    static void onExit();
+
+    void write(const std::string& path, const std::string& value);
+    void save(const std::string& path);
+    void writeJournal();
+    void recover();
+    void restoreUnsafe(); // async-signal-safe
+    long readKhz(int cpu, const char* file);
+};
+
+inline std::atomic<FrequencyControl*> FrequencyControl::active(nullptr);
+
+inline FrequencyControl::FrequencyControl(const std::string& _root, const std::string& _journal)
+    : root(_root), journal(_journal), saved(new Saved[MAXSAVED]), count(0) {
+    if (journal.size() >= PATHLEN) {
+        throw std::invalid_argument("Journal path too long: " + journal);
+    }
+    strcpy(journalPath, journal.c_str());
+    FrequencyControl* expected = nullptr;
+    if (!active.compare_exchange_strong(expected, this)) {
+        throw std::logic_error("Another FrequencyControl is already active");
+    }
+    try {
+        recover();
+    } catch (...) {
+        active.store(nullptr);
+        throw;
+    }
+    static bool hooked = false;
+    if (!hooked) {
+        hooked = true;
+        std::atexit(onExit);
+        for (int sig : {SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGPIPE, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+            std::signal(sig, onSignal);
+        }
+    }
+}
+
+inline FrequencyControl::~FrequencyControl() {
+    restore();
+    active.store(nullptr);
+}
+
+inline void FrequencyControl::onSignal(int sig) {
+    FrequencyControl* fc = active.load();
+    if (fc != nullptr) {
+        fc->restoreUnsafe();
+        if (fc->journalPath[0] != '\0') {
+            unlink(fc->journalPath);
+        }
+    }
+    std::signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+inline void FrequencyControl::onExit() {
+    FrequencyControl* fc = active.load();
+    if (fc != nullptr) {
+        fc->restore();
+    }
+}
+
+inline void FrequencyControl::write(const std::string& path, const std::string& value) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_TRUNC);
+    if (fd < 0 || ::write(fd, value.c_str(), value.size()) != (ssize_t)value.size()) {
+        int err = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::runtime_error("Cannot write " + value + " to " + path + ": " + strerror(err));
+    }
+    close(fd);
+}
+
+// Remembers path's current contents the first time it is about to change
+inline void FrequencyControl::save(const std::string& path) {
+    int n = count.load();
+    for (int i = 0; i < n; i++) {
+        if (path == saved[i].path) {
+            return;
+        }
+    }
+    if (n == MAXSAVED || path.size() >= PATHLEN) {
+        throw std::length_error("Too many frequency settings to save");
+    }
+    std::ifstream in(path);
+    std::string value;
+    if (!(in >> value) || value.size() >= sizeof(saved[n].value)) {
+        throw std::runtime_error("Cannot read " + path);
+    }
+    Saved& s = saved[n];
+    strcpy(s.path, path.c_str());
+    strcpy(s.value, value.c_str());
+    s.length = value.size();
+    count.store(n + 1); // publish only once complete, the handler may run at any point
+    writeJournal();
+}
+
+// journal: one "path value" per line
+inline void FrequencyControl::writeJournal() {
+    if (journal.empty()) {
+        return;
+    }
+    std::string tmp = journal + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios_base::trunc);
+        for (int i = 0; i < count.load(); i++) {
+            out << saved[i].path << " " << saved[i].value << "\n";
+        }
+        if (!out.good()) {
+            throw std::runtime_error("Cannot write frequency journal " + tmp);
+        }
+    }
+    if (rename(tmp.c_str(), journal.c_str()) != 0) {
+        throw std::runtime_error("Cannot write frequency journal " + journal);
+    }
+}
+
+// Puts back whatever an earlier, killed run left in the journal
+inline void FrequencyControl::recover() {
+    if (journal.empty()) {
+        return;
+    }
+    std::ifstream in(journal);
+    if (!in.is_open()) {
+        return;
+    }
+    std::string path, value;
+    int restored = 0;
+    while (in >> path >> value) {
+        write(path, value);
+        restored++;
+    }
+    in.close();
+    unlink(journal.c_str());
+    std::cerr << "Restored " << restored << " frequency settings left by an interrupted run" << std::endl;
+}
+
+inline long FrequencyControl::readKhz(int cpu, const char* file) {
+    std::ifstream in(root + "/cpu" + std::to_string(cpu) + "/cpufreq/" + file);
+    long khz;
+    if (!(in >> khz)) {
+        throw std::runtime_error("Cannot read " + std::string(file) + " of CPU " + std::to_string(cpu));
+    }
+    return khz;
+}
+
+// Sets the CPU's maximum frequency; a cap below the current minimum lowers the
+// minimum with it, since cpufreq rejects max < min
+inline void FrequencyControl::cap(int cpu, long khz) {
+    std::string dir = root + "/cpu" + std::to_string(cpu) + "/cpufreq/";
+    if (khz < readKhz(cpu, "scaling_min_freq")) {
+        save(dir + "scaling_min_freq");
+        write(dir + "scaling_min_freq", std::to_string(khz));
+    }
+    save(dir + "scaling_max_freq");
+    write(dir + "scaling_max_freq", std::to_string(khz));
+}
+
+// "0-25:1200000/26-27:4200000": cpu lists with a kHz value, or min / max for
+// the CPU's hardware limits
+inline void FrequencyControl::apply(const std::string& spec) {
+    std::stringstream in(spec);
+    std::string entry;
+    while (std::getline(in, entry, '/')) {
+        size_t colon = entry.rfind(':');
+        if (colon == std::string::npos) {
+            throw std::invalid_argument("Expected cpus:kHz in frequency spec, got " + entry);
+        }
+        std::vector<int> cpus = Topology::parseList(entry.substr(0, colon));
+        std::string value = entry.substr(colon + 1);
+        for (int cpu : cpus) {
+            long khz;
+            if (value == "max") {
+                khz = readKhz(cpu, "cpuinfo_max_freq");
+            } else if (value == "min") {
+                khz = readKhz(cpu, "cpuinfo_min_freq");
+            } else {
+                try {
+                    khz = std::stol(value);
+                } catch (const std::exception&) {
+                    throw std::invalid_argument("Bad frequency " + value + " in " + entry);
+                }
+            }
+            cap(cpu, khz);
+        }
+    }
+}
+
+// max is put back before min so the pair never passes through max < min
+inline void FrequencyControl::restore() {
+    restoreUnsafe();
+    count.store(0);
+    if (!journal.empty()) {
+        unlink(journal.c_str());
+    }
+}
+
+inline void FrequencyControl::restoreUnsafe() {
+    int n = count.load();
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = n - 1; i >= 0; i--) {
+            bool isMin = strstr(saved[i].path, "scaling_min_freq") != nullptr;
+            if (isMin != (pass == 1)) {
+                continue;
+            }
+            int fd = ::open(saved[i].path, O_WRONLY | O_TRUNC);
+            if (fd >= 0) {
+                if (::write(fd, saved[i].value, saved[i].length) < 0) {
+                    // nothing safe to report from here
+                }
+                close(fd);
+            }
+        }
+    }
+}
+
+inline int FrequencyControl::changed() const {
+    return count.load();
+}
@@ -0,0 +1,286 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <functional>
+#include <stdexcept>
+#include <condition_variable>
+#include <mutex>
+
+#include "Locks.h"
+
+// Runs up to max threads with only the first limit() of them active; the
+// rest park on a futex until the limit rises or the work runs out. A
+// background loop moves the limit by hill climbing on live throughput and
+// energy feedback toward one of two objectives:
+//   throughput - most ops/s while package power stays under a cap
+//   energy     - fewest joules per op while ops/s stays above a floor
+// The climb starts with a step of a quarter of the range, keeps direction
+// while the objective improves and reverses with half the step when it
+// gets worse, so it settles on a thread count instead of oscillating
+// across the whole range.
+class Governor {
+public:
+    enum Objective { THROUGHPUT, ENERGY };
+
+    Governor(int _max, int _min);
+    ~Governor();
+
+    static Objective objectiveNamed(const std::string& name);
+    bool admitted(int rank) const;
+    void park(int rank);
+    void finish();
+    void start(Objective _objective, std::function<double()> _joules, std::function<long()> _ops,
+               std::chrono::milliseconds interval, double _powerCap, double _minThroughput);
+    void stop();
+    int limit() const;
+    double meanLimit() const;
+    long steps() const;
+
+private:
+    int max;
+    int min;
+    alignas(64) std::atomic<int> active; // futex word, ranks >= active park
+    std::atomic<bool> done;
+    std::mutex limitMutex; // a lowered limit must never land after finish()
+
+    Objective objective;
+    std::function<double()> joules;
+    std::function<long()> ops;
+    double powerCap;
+    double minThroughput;
+    std::atomic<long> moves;
+    double limitSum;
+    long intervals;
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool running;
+    std::thread worker;
+
+    void setLimit(int n);
+    void loop(std::chrono::milliseconds interval);
+};
+
+inline Governor::Governor(int _max, int _min) : max(_max), min(std::max(1, std::min(_min, _max))), running(false) {
+    if (max < 1) {
+        throw std::invalid_argument("Governor needs at least one thread");
+    }
+    active.store(max);
+    done.store(false);
+    moves.store(0);
+    limitSum = 0.0;
+    intervals = 0;
+}
+
+inline Governor::~Governor() {
+    stop();
+}
+
+inline Governor::Objective Governor::objectiveNamed(const std::string& name) {
+    if (name == "throughput") return THROUGHPUT;
+    if (name == "energy") return ENERGY;
+    throw std::invalid_argument("Unknown governor objective " + name + ", expected off, throughput or energy");
+}
+
+inline bool Governor::admitted(int rank) const {
+    return rank < active.load(std::memory_order_relaxed) || done.load(std::memory_order_relaxed);
+}
+
+// Blocks while rank is above the limit
+inline void Governor::park(int rank) {
+    while (true) {
+        int seen = active.load(std::memory_order_acquire);
+        if (rank < seen || done.load()) {
+            return;
+        }
+        futexWait(&active, seen);
+    }
+}
+
+// No work left: every parked thread is let go so it can see that and exit
+inline void Governor::finish() {
+    std::lock_guard<std::mutex> lock(limitMutex);
+    done.store(true);
+    // raising the word also fails any futexWait that raced with the flag
+    active.store(max, std::memory_order_release);
+    futexWake(&active, INT_MAX);
+}
+
+inline void Governor::setLimit(int n) {
+    std::lock_guard<std::mutex> lock(limitMutex);
+    n = std::max(min, std::min(max, n));
+    if (!done.load() && n != active.load()) {
+        active.store(n, std::memory_order_release);
+        futexWake(&active, INT_MAX);
+        moves++;
+    }
+}
+
+inline void Governor::start(Objective _objective, std::function<double()> _joules, std::function<long()> _ops,
+                            std::chrono::milliseconds interval, double _powerCap, double _minThroughput) {
+    std::lock_guard<std::mutex> lock(m);
+    if (running) {
+        return;
+    }
+    objective = _objective;
+    joules = _joules;
+    ops = _ops;
+    powerCap = _powerCap;
+    minThroughput = _minThroughput;
+    running = true;
+    worker = std::thread(&Governor::loop, this, interval);
+}
+
+// Stops adjusting and lets every thread run
+inline void Governor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        running = false;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    setLimit(max);
+}
+
+inline void Governor::loop(std::chrono::milliseconds interval) {
+    std::unique_lock<std::mutex> lock(m);
+    double lastJoules = joules();
+    long lastOps = ops();
+    std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
+    double lastScore = 0.0;
+    bool haveScore = false;
+    int step = std::max(1, (max - min) / 4);
+    int direction = -1; // oversubscription is the usual starting point
+    while (!cv.wait_for(lock, interval, [this] { return !running; })) {
+        double nowJoules = joules();
+        long nowOps = ops();
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - lastTime).count();
+        long ran = nowOps - lastOps;
+        double throughput = ran / seconds;
+        double power = (nowJoules - lastJoules) / seconds;
+        lastJoules = nowJoules;
+        lastOps = nowOps;
+        lastTime = now;
+        limitSum += active.load();
+        intervals++;
+        if (ran == 0 || done.load()) {
+            continue; // nothing ran or nothing left, nothing to learn
+        }
+
+        // constraint first, then the objective; higher score is better
+        int current = active.load();
+        if (objective == THROUGHPUT && powerCap > 0 && power > powerCap) {
+            setLimit(current - step);
+            direction = -1;
+            haveScore = false;
+            continue;
+        }
+        if (objective == ENERGY && throughput < minThroughput) {
+            setLimit(current + step);
+            direction = 1;
+            haveScore = false;
+            continue;
+        }
+        double score = objective == THROUGHPUT ? throughput : (power > 0 ? -power / throughput : throughput);
+        if (haveScore && score < lastScore) {
+            direction = -direction;
+            step = std::max(1, step / 2);
+        }
+        lastScore = score;
+        haveScore = true;
+        setLimit(current + direction * step);
+    }
+}
+
+inline int Governor::limit() const {
+    return active.load();
+}
+
+inline double Governor::meanLimit() const {
+    return intervals > 0 ? limitSum / intervals : active.load();
+}
+
+inline long Governor::steps() const {
+    return moves.load();
+}
+
+// Hands out a run's operations. Ungoverned, every thread does its own fixed
+// quota as before. Governed, threads draw chunks from one shared pool so the
+// work of parked threads is picked up by the running ones, and check the
+// governor between operations.
+class WorkPool {
+public:
+    WorkPool(int threads, Governor* _governor);
+    void assign(int thread, long quota);
+    void share(long total);
+    bool take(int thread);
+    long done() const;
+
+private:
+    static const long CHUNK = 256;
+
+    struct alignas(64) Local {
+        long left = 0;
+        std::atomic<long> done{0};
+    };
+
+    Governor* governor;
+    bool shared;
+    alignas(64) std::atomic<long> pool;
+    std::unique_ptr<Local[]> local;
+    int count;
+};
+
+inline WorkPool::WorkPool(int threads, Governor* _governor)
+    : governor(_governor), shared(false), local(new Local[threads]), count(threads) {
+    pool.store(0);
+}
+
+// Back to fixed quotas
+inline void WorkPool::assign(int thread, long quota) {
+    shared = false;
+    local[thread].left = quota;
+}
+
+inline void WorkPool::share(long total) {
+    shared = true;
+    pool.store(total);
+}
+
+// True while thread should do one more operation
+inline bool WorkPool::take(int thread) {
+    Local& l = local[thread];
+    if (shared && governor != nullptr && !governor->admitted(thread)) {
+        governor->park(thread);
+    }
+    if (l.left == 0 && shared) {
+        long got = pool.fetch_sub(CHUNK);
+        l.left = got <= 0 ? 0 : std::min(got, CHUNK);
+        if (l.left == 0 && governor != nullptr) {
+            governor->finish();
+        }
+    }
+    if (l.left == 0) {
+        return false;
+    }
+    l.left--;
+    l.done.store(l.done.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// Operations taken so far, summed over threads
+inline long WorkPool::done() const {
+    long total = 0;
+    for (int i = 0; i < count; i++) {
+        total += local[i].done.load(std::memory_order_relaxed);
+    }
+    return total;
+}
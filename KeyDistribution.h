@@ -0,0 +1,173 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+
+#include "BenchUtil.h"
+#include "Record.h"
+
+// Picks keys (accounts, list indices or values) in [0, keys) with one of
+//   uniform - every key equally likely
+//   zipf    - key of rank r drawn with probability proportional to
+//             1 / (r+1)^theta (Gray et al.'s generator, 0 < theta < 1)
+//   hotset  - hotOps of the draws go to a hot set of hotKeys of the keys
+//   bursty  - like hotset, but the hot set moves to a different region of the
+//             key space every burstMs, so caches and lock queues keep
+//             re-forming around new hot keys
+// Ranks are scattered over the key space by a fixed multiplicative
+// permutation, so the hottest keys are not neighbours sharing cache lines. A
+// draw also reports whether it hit the hot set: the hotKeys fraction of
+// lowest ranks (the current window for bursty), which for uniform is just a
+// reference set that gets hotKeys of the draws.
+class KeyDistribution {
+public:
+    enum Kind { UNIFORM, ZIPF, HOTSET, BURSTY };
+
+    KeyDistribution(int _keys, const std::string& kind, double _theta, double hotKeys, double _hotOps, long burstMs);
+
+    static Kind kindNamed(const std::string& name);
+    int next(bool& hot);
+    int hotCount() const;
+    bool skewed() const;
+
+private:
+    int keys;
+    Kind kind;
+    double theta;
+    int hot; // keys in the hot set
+    double hotOps;
+    long burstNs;
+    unsigned long stride; // rank -> key permutation, coprime with keys
+    double zetaN; // zipf constants
+    double alpha;
+    double eta;
+    double half; // 1 + 0.5^theta
+
+    int key(long rank) const;
+    static double uniform();
+};
+
+inline KeyDistribution::KeyDistribution(int _keys, const std::string& name, double _theta, double hotKeys,
+                                        double _hotOps, long burstMs)
+    : keys(_keys), kind(kindNamed(name)), theta(_theta), hotOps(_hotOps), burstNs(burstMs * 1000000) {
+    if (keys < 1) {
+        throw std::invalid_argument("Need at least one key");
+    }
+    if (hotKeys <= 0 || hotKeys > 1 || hotOps < 0 || hotOps > 1) {
+        throw std::invalid_argument("hotkeys must be in (0, 1] and hotops in [0, 1]");
+    }
+    if (kind == BURSTY && burstMs <= 0) {
+        throw std::invalid_argument("Bursty keys need burstms > 0");
+    }
+    hot = std::max(1, (int)(hotKeys * keys));
+    stride = 2654435761UL % keys;
+    while (keys > 1 && (stride == 0 || std::gcd(stride, (unsigned long)keys) != 1)) {
+        stride++;
+    }
+    zetaN = alpha = eta = half = 0.0;
+    if (kind == ZIPF) {
+        if (theta <= 0 || theta >= 1) {
+            throw std::invalid_argument("Zipf theta must be in (0, 1)");
+        }
+        for (long i = 1; i <= keys; i++) {
+            zetaN += 1.0 / std::pow((double)i, theta);
+        }
+        double zeta2 = 1.0 + std::pow(0.5, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / keys, 1.0 - theta)) / (1.0 - zeta2 / zetaN);
+        half = zeta2;
+    }
+}
+
+inline KeyDistribution::Kind KeyDistribution::kindNamed(const std::string& name) {
+    if (name == "uniform") return UNIFORM;
+    if (name == "zipf") return ZIPF;
+    if (name == "hotset") return HOTSET;
+    if (name == "bursty") return BURSTY;
+    throw std::invalid_argument("Unknown key distribution " + name + ", expected uniform, zipf, hotset or bursty");
+}
+
+inline double KeyDistribution::uniform() {
+    return (threadRandom().next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline int KeyDistribution::key(long rank) const {
+    return (int)((rank * stride) % keys);
+}
+
+inline int KeyDistribution::next(bool& isHot) {
+    long rank;
+    switch (kind) {
+    case ZIPF: {
+        double u = uniform();
+        double uz = u * zetaN;
+        if (uz < 1.0) {
+            rank = 0;
+        } else if (uz < half) {
+            rank = 1;
+        } else {
+            rank = std::min((long)keys - 1, (long)(keys * std::pow(eta * u - eta + 1.0, alpha)));
+        }
+        isHot = rank < hot;
+        return key(rank);
+    }
+    case HOTSET:
+    case BURSTY: {
+        isHot = hot == keys || uniform() < hotOps;
+        rank = isHot ? threadRandom().below(hot) : hot + threadRandom().below(keys - hot);
+        if (kind == BURSTY) {
+            long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            uint64_t phase = now / burstNs;
+            rank = (rank + (long)((phase * 0x9e3779b97f4a7c15ULL) % keys)) % keys;
+        }
+        return key(rank);
+    }
+    default:
+        rank = threadRandom().below(keys);
+        isHot = rank < hot;
+        return key(rank);
+    }
+}
+
+inline int KeyDistribution::hotCount() const {
+    return hot;
+}
+
+inline bool KeyDistribution::skewed() const {
+    return kind != UNIFORM;
+}
+
+// Operations and sampled latency of one thread, split by whether they touched
+// a hot key. Index 1 is hot, 0 cold.
+struct HotColdStats {
+    long ops[2] = {0, 0};
+    double latencyNs[2] = {0.0, 0.0};
+    long sampled[2] = {0, 0};
+
+    void add(const HotColdStats& o) {
+        for (int h = 0; h < 2; h++) {
+            ops[h] += o.ops[h];
+            latencyNs[h] += o.latencyNs[h];
+            sampled[h] += o.sampled[h];
+        }
+    }
+
+    // Prints one line and adds <what>_hot_ops, <what>_cold_ops and, when
+    // latency was sampled, <what>_hot_latency_ns and <what>_cold_latency_ns
+    void report(const std::string& what, int hotKeys, int keys, Record& rec) const {
+        static const char* names[2] = {"cold", "hot"};
+        printf("Hot %s (%d of %d): %ld ops, cold: %ld ops", what.c_str(), hotKeys, keys, ops[1], ops[0]);
+        for (int h = 1; h >= 0; h--) {
+            rec.add(what + "_" + names[h] + "_ops", ops[h]);
+            if (sampled[h] > 0) {
+                printf(", %s mean latency %.0lf ns", names[h], latencyNs[h] / sampled[h]);
+                rec.add(what + "_" + names[h] + "_latency_ns", latencyNs[h] / sampled[h]);
+            }
+        }
+        printf("\n");
+    }
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+#include "Record.h"
+
+// High-dynamic-range latency histogram in the style of HdrHistogram: every
+// power of two is split into 64 linear sub-buckets, so any recorded value is
+// reported within 1.6% across 1 ns to over an hour. Written by one thread;
+// per-thread histograms are merged with add() once the threads are joined.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(long ns);
+    void add(const LatencyHistogram& other);
+    long count() const;
+    long percentile(double p) const;
+    long max() const;
+    double mean() const;
+    void report(const std::string& op, Record& rec) const;
+
+private:
+    static const int SUBBITS = 6;
+    static const int HALF = 1 << SUBBITS; // sub-buckets per power of two
+    static const int MAXSHIFT = 36; // top bucket starts at 2^42 ns
+
+    std::vector<long> counts;
+    long total;
+    long maxNs;
+    double sumNs;
+
+    static int index(long ns);
+    static long highest(int index); // largest value that lands in index
+};
+
+inline LatencyHistogram::LatencyHistogram()
+    : counts((MAXSHIFT + 2) * HALF, 0), total(0), maxNs(0), sumNs(0.0) {
+}
+
+// values below 2 * HALF get a bucket each; above that the top SUBBITS + 1
+// bits pick the bucket
+inline int LatencyHistogram::index(long ns) {
+    if (ns < 0) {
+        ns = 0;
+    }
+    int msb = 63 - __builtin_clzll((unsigned long long)ns | 1);
+    int shift = std::max(0, msb - SUBBITS);
+    if (shift > MAXSHIFT) {
+        return (MAXSHIFT + 2) * HALF - 1;
+    }
+    return shift * HALF + (int)(ns >> shift);
+}
+
+inline long LatencyHistogram::highest(int index) {
+    int shift = std::max(0, index / HALF - 1);
+    long base = (long)(index - shift * HALF) << shift;
+    return base + (1L << shift) - 1;
+}
+
+inline void LatencyHistogram::record(long ns) {
+    counts[index(ns)]++;
+    total++;
+    maxNs = std::max(maxNs, ns);
+    sumNs += ns;
+}
+
+inline void LatencyHistogram::add(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts.size(); i++) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    maxNs = std::max(maxNs, other.maxNs);
+    sumNs += other.sumNs;
+}
+
+inline long LatencyHistogram::count() const {
+    return total;
+}
+
+// Smallest recorded value at or above the p-th quantile, 0 <= p <= 1
+inline long LatencyHistogram::percentile(double p) const {
+    if (total == 0) {
+        return 0;
+    }
+    long rank = std::max(1L, (long)(p * total + 0.5));
+    long seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(highest(i), maxNs);
+        }
+    }
+    return maxNs;
+}
+
+inline long LatencyHistogram::max() const {
+    return maxNs;
+}
+
+inline double LatencyHistogram::mean() const {
+    return total > 0 ? sumNs / total : 0.0;
+}
+
+// Prints one line and adds <op>_ops, <op>_p50_ns, <op>_p99_ns, <op>_p999_ns
+// and <op>_max_ns to rec
+inline void LatencyHistogram::report(const std::string& op, Record& rec) const {
+    printf("Latency %s: %ld ops, mean %.0lf ns, p50 %ld ns, p99 %ld ns, p99.9 %ld ns, max %ld ns\n", op.c_str(),
+           total, mean(), percentile(0.5), percentile(0.99), percentile(0.999), maxNs);
+    rec.add(op + "_ops", total);
+    rec.add(op + "_mean_ns", mean());
+    rec.add(op + "_p50_ns", percentile(0.5));
+    rec.add(op + "_p99_ns", percentile(0.99));
+    rec.add(op + "_p999_ns", percentile(0.999));
+    rec.add(op + "_max_ns", maxNs);
+}
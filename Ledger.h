@@ -0,0 +1,164 @@
+#pragma once
+#include <vector>
+#include <stdexcept>
+
+#include "Search.h"
+
+// One leg of a batch: amt moves from account from to account to
+struct Transfer {
+    int from;
+    int to;
+    long long amt;
+};
+
+// Flat account ledger: accounts live in one contiguous array indexed by
+// account id and amounts are integers (fixed-point, e.g. cents) so totals
+// are exact. With Padded = true every account gets its own cache line so
+// transfers on neighbouring accounts do not false-share.
+template <bool Padded = false>
+class Ledger {
+public:
+    // balance() is only consistent while transfers are locked out
+    static const bool consistentBalance = false;
+
+    Ledger(int _accounts, long long initial);
+    long long get(int acct);
+    void set(int acct, long long amount);
+    void transfer(int from, int to, long long amt);
+    void transferBatch(const Transfer* batch, int n);
+    // Same calls as the epoch ledgers take; a flat ledger keeps no per-thread state
+    void transfer(int /*threadNum*/, int from, int to, long long amt) { transfer(from, to, amt); }
+    void transferBatch(int /*threadNum*/, const Transfer* batch, int n) { transferBatch(batch, n); }
+    long long balance();
+    int size();
+
+private:
+    struct alignas(Padded ? 64 : alignof(long long)) Account {
+        long long amount;
+    };
+
+    int accounts;
+    std::vector<Account> data;
+
+    static long long sumPacked(const long long* amounts, int n);
+#ifdef SEARCH_X86
+    static long long sumSse2(const long long* amounts, int n);
+    static long long sumAvx2(const long long* amounts, int n);
+#endif
+};
+
+template <bool Padded>
+Ledger<Padded>::Ledger(int _accounts, long long initial) {
+    if (_accounts < 0) {
+        throw std::invalid_argument("Account count cannot be negative");
+    }
+    accounts = _accounts;
+    data.resize(accounts);
+    for (int i = 0; i < accounts; i++) {
+        data[i].amount = initial;
+    }
+}
+
+template <bool Padded>
+long long Ledger<Padded>::get(int acct) {
+    return data[acct].amount;
+}
+
+template <bool Padded>
+void Ledger<Padded>::set(int acct, long long amount) {
+    data[acct].amount = amount;
+}
+
+// Caller is responsible for holding whatever locks protect from and to
+template <bool Padded>
+void Ledger<Padded>::transfer(int from, int to, long long amt) {
+    data[from].amount -= amt;
+    data[to].amount += amt;
+}
+
+// Caller holds the locks for every account the batch touches
+template <bool Padded>
+void Ledger<Padded>::transferBatch(const Transfer* batch, int n) {
+    for (int i = 0; i < n; i++) {
+        transfer(batch[i].from, batch[i].to, batch[i].amt);
+    }
+}
+
+template <bool Padded>
+int Ledger<Padded>::size() {
+    return accounts;
+}
+
+template <bool Padded>
+long long Ledger<Padded>::balance() {
+    if (!Padded) {
+        // Account is exactly one long long here, so the array is packed
+        return accounts > 0 ? sumPacked(&data[0].amount, accounts) : 0;
+    }
+    long long total = 0;
+    for (int i = 0; i < accounts; i++) {
+        total += data[i].amount;
+    }
+    return total;
+}
+
+// Vectorized with the same run-time choice of AVX2 or SSE2 as the list
+// search kernels (Search.h), so a build without -mavx2 still gets AVX2
+template <bool Padded>
+long long Ledger<Padded>::sumPacked(const long long* amounts, int n) {
+#ifdef SEARCH_X86
+    switch (searchKernel()) {
+    case SEARCH_AVX2:
+        return sumAvx2(amounts, n);
+    case SEARCH_SSE2:
+        return sumSse2(amounts, n);
+    default:
+        break;
+    }
+#endif
+    long long total = 0;
+    for (int i = 0; i < n; i++) {
+        total += amounts[i];
+    }
+    return total;
+}
+
+#ifdef SEARCH_X86
+template <bool Padded>
+long long Ledger<Padded>::sumSse2(const long long* amounts, int n) {
+    int i = 0;
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_epi64(acc0, _mm_loadu_si128((const __m128i*)(amounts + i)));
+        acc1 = _mm_add_epi64(acc1, _mm_loadu_si128((const __m128i*)(amounts + i + 2)));
+    }
+    acc0 = _mm_add_epi64(acc0, acc1);
+    alignas(16) long long lanes[2];
+    _mm_store_si128((__m128i*)lanes, acc0);
+    long long total = lanes[0] + lanes[1];
+    for (; i < n; i++) {
+        total += amounts[i];
+    }
+    return total;
+}
+
+template <bool Padded>
+__attribute__((target("avx2"))) long long Ledger<Padded>::sumAvx2(const long long* amounts, int n) {
+    int i = 0;
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256((const __m256i*)(amounts + i)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256((const __m256i*)(amounts + i + 4)));
+    }
+    acc0 = _mm256_add_epi64(acc0, acc1);
+    alignas(32) long long lanes[4];
+    _mm256_store_si256((__m256i*)lanes, acc0);
+    long long total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; i++) {
+        total += amounts[i];
+    }
+    return total;
+}
+#endif
@@ -0,0 +1,434 @@
+#pragma once
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <random>
+
+#include "BenchUtil.h"
+#include "Config.h"
+#include "Record.h"
+#include "EnergySampler.h"
+#include "Placement.h"
+#include "ArrayList.h"
+#include "ConcurrentList.h"
+#include "ScanPool.h"
+#include "MPMCQueue.h"
+#include "LockProfile.h"
+#include "LatencyHistogram.h"
+#include "ArrivalPacer.h"
+#include "Trace.h"
+#include "KeyDistribution.h"
+
+// The list benchmark that used to be test.cpp: a few producer threads push
+// contains requests to the queue and do set/get themselves, the remaining
+// threads serve the contains requests.
+class ListBench {
+public:
+    ListBench(const Config& _cfg, EnergySampler& _sampler, Placement& _placement);
+    bool run(Record& rec);
+
+private:
+    struct ContainsRequest {
+        int value;
+        long due; // open loop: when the request was issued, 0 in closed loop
+        bool hot;
+    };
+
+    // operation types with an open-loop latency histogram; get and set are
+    // also split by index hotness, contains by value hotness
+    enum LatencyOp { GET, SET, ADD, CONTAINS, HOT_INDEX, COLD_INDEX, HOT_CONTAINS, COLD_CONTAINS, LATENCYOPS };
+
+    const Config& cfg;
+    EnergySampler& sampler;
+    Placement& placement;
+    int threads;
+    int containsThreads;
+    int size;
+    int containsPer;
+    int addsPer;
+    int appends;
+    int containsBatch;
+    long iterations;
+    double rate; // offered operations/s across the producers, 0 for closed loop
+    ArrivalPacer::Distribution arrival;
+    uint64_t seed; // per-thread generator seed, 0 for unseeded
+
+    ConcurrentList<int> list;
+    MPMCQueue<ContainsRequest> containsQueue;
+    std::vector<ThreadStats> stats;
+    LockProfiler profiler;
+    std::vector<LatencyHistogram> latency; // LATENCYOPS per thread, open loop only
+    std::unique_ptr<Trace> trace; // producer operations are replayed from here when set
+    std::unique_ptr<ScanPool> scanPool; // splits each contains across idle threads when set
+    KeyDistribution indexKeys; // list positions read and written
+    KeyDistribution valueKeys; // values set and searched for, less one
+    std::vector<HotColdStats> indexStats; // per producer, gets and sets
+    std::vector<HotColdStats> valueStats; // per contains thread
+
+    int generateRandomVal(bool& hot);
+    int generateRandomIndex(bool& hot);
+    TraceOp generateOp();
+    void loadTrace(int producers, long iter, Record& rec);
+    void completed(int threadNum, LatencyOp type, long due);
+    void do_work(int threadNum, long iter);
+    void do_workContains(int threadNum);
+    void do_workSynch(ArrayList<int>& seqList, int threadNum, long iter);
+    void finish(int threadNum, std::chrono::high_resolution_clock::time_point t1, long ops);
+    void probeScan(Record& rec);
+};
+
+inline ListBench::ListBench(const Config& _cfg, EnergySampler& _sampler, Placement& _placement)
+    : cfg(_cfg), sampler(_sampler), placement(_placement), list(cfg.getInt("size"), cfg.getString("stripemode") == "seqlock"),
+      containsQueue(cfg.getInt("queuesize")),
+      indexKeys(std::max(1L, cfg.getInt("size")), cfg.getString("keydist"), cfg.getDouble("zipftheta"),
+                cfg.getDouble("hotkeys"), cfg.getDouble("hotops"), cfg.getInt("burstms")),
+      valueKeys(std::max(1L, cfg.getInt("size")),
+                cfg.getString("valuedist").empty() ? cfg.getString("keydist") : cfg.getString("valuedist"),
+                cfg.getDouble("zipftheta"), cfg.getDouble("hotkeys"), cfg.getDouble("hotops"), cfg.getInt("burstms")) {
+    threads = cfg.getInt("threads");
+    containsThreads = cfg.getInt("containsthreads");
+    size = cfg.getInt("size");
+    containsPer = cfg.getInt("containsper");
+    addsPer = cfg.getInt("addsper");
+    appends = cfg.getInt("appends");
+    containsBatch = std::max(1L, cfg.getInt("containsbatch"));
+    iterations = cfg.getInt("iterations");
+    if (cfg.getString("stripemode") != "shared" && cfg.getString("stripemode") != "seqlock") {
+        throw std::invalid_argument("Unknown stripemode " + cfg.getString("stripemode") + ", expected shared or seqlock");
+    }
+    if (threads <= 0 || containsThreads < 0 || containsThreads >= threads || size < 1) {
+        throw std::invalid_argument("Need size >= 1 and 0 <= containsthreads < threads");
+    }
+    stats.resize(threads);
+    indexStats.resize(threads);
+    valueStats.resize(threads);
+    rate = cfg.getDouble("rate");
+    seed = cfg.getInt("seed");
+    arrival = ArrivalPacer::distributionNamed(cfg.getString("arrival"));
+    if (rate > 0) {
+        latency.resize(threads * LATENCYOPS);
+    }
+    setSearchKernel(searchKernelNamed(cfg.getString("search")));
+    if (cfg.getInt("valueindex") != 0) {
+        list.indexValues(cfg.getInt("indexshards"));
+    }
+    if (cfg.getInt("scanthreads") > 0) {
+        scanPool.reset(new ScanPool(cfg.getInt("scanthreads")));
+    }
+    if (cfg.getInt("lockprofile") != 0) {
+        list.profile(profiler.group("stripe", list.stripes()));
+    }
+}
+
+// 1..size
+inline int ListBench::generateRandomVal(bool& hot) {
+    return valueKeys.next(hot) + 1;
+}
+
+// 0..size-1
+inline int ListBench::generateRandomIndex(bool& hot) {
+    return indexKeys.next(hot);
+}
+
+// A producer operation drawn now: contains, set or get by containsper /
+// addsper, with appends% of the sets appending instead. Contains is hot by
+// its value, set and get by their index; appends are not classified.
+inline TraceOp ListBench::generateOp() {
+    TraceOp o = TraceOp();
+    bool hot, valueHot;
+    int num = generateRandomInt(1, 100);
+    if (num <= containsPer) {
+        o.kind = TRACE_CONTAINS;
+        o.a = generateRandomVal(hot);
+    } else if (num <= addsPer && appends > 0 && generateRandomInt(1, 100) <= appends) {
+        o.kind = TRACE_ADD;
+        o.a = generateRandomVal(hot);
+        hot = false;
+    } else if (num <= addsPer) {
+        o.kind = TRACE_SET;
+        o.a = generateRandomIndex(hot);
+        o.b = generateRandomVal(valueHot);
+    } else {
+        o.kind = TRACE_GET;
+        o.a = generateRandomIndex(hot);
+    }
+    o.flags = hot ? TRACE_HOT : 0;
+    return o;
+}
+
+// tracemode=record writes each producer's operations to the trace first;
+// either way the trace is mapped and checked before the clock starts
+inline void ListBench::loadTrace(int producers, long iter, Record& rec) {
+    std::string path = cfg.getString("trace");
+    std::string traceMode = cfg.getString("tracemode");
+    if (traceMode == "record") {
+        uint64_t traceSeed = seed != 0 ? seed : threadRandom().next();
+        std::vector<std::vector<TraceOp>> streams(producers);
+        for (int i = 0; i < producers; i++) {
+            seedThreadRandom(traceSeed, i);
+            for (long k = 0; k < iter; k++) {
+                streams[i].push_back(generateOp());
+            }
+        }
+        Trace::write(path, streams, traceSeed);
+    } else if (traceMode != "replay") {
+        throw std::invalid_argument("Unknown tracemode " + traceMode + ", expected replay or record");
+    }
+    trace.reset(new Trace(path));
+    if (trace->threads() < producers) {
+        throw std::runtime_error("Trace " + path + " has " + std::to_string(trace->threads()) + " streams, " +
+                                 std::to_string(producers) + " producers need one each");
+    }
+    for (int t = 0; t < trace->threads(); t++) {
+        const TraceOp* ops = trace->ops(t);
+        for (long k = 0; k < trace->count(t); k++) {
+            if (ops[k].kind != TRACE_GET && ops[k].kind != TRACE_SET && ops[k].kind != TRACE_CONTAINS &&
+                ops[k].kind != TRACE_ADD) {
+                throw std::runtime_error("Trace " + path + " is not a list trace");
+            }
+            if ((ops[k].kind == TRACE_GET || ops[k].kind == TRACE_SET) && (ops[k].a < 0 || ops[k].a >= size)) {
+                throw std::runtime_error("Trace " + path + " has indexes outside 0.." + std::to_string(size - 1));
+            }
+        }
+    }
+    std::cout << "Replaying " << trace->total() << " operations from " << path << " (seed " << trace->seed() << ")" << std::endl;
+    rec.add("trace_ops", trace->total());
+    rec.add("trace_seed", std::to_string(trace->seed()));
+}
+
+// Charges an open-loop operation the time since it was due
+inline void ListBench::completed(int threadNum, LatencyOp type, long due) {
+    if (due != 0) {
+        latency[threadNum * LATENCYOPS + type].record(ArrivalPacer::now() - due);
+    }
+}
+
+inline void ListBench::finish(int threadNum, std::chrono::high_resolution_clock::time_point t1, long ops) {
+    using namespace std::chrono;
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    stats[threadNum].time = duration_cast<duration<double>>(t2 - t1).count();
+    stats[threadNum].ops = ops;
+}
+
+inline void ListBench::do_work(int threadNum, long iter) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    if (seed != 0) {
+        seedThreadRandom(seed, threadNum);
+    }
+    std::random_device rd;
+    ArrivalPacer arrivals(rate / (threads - containsThreads), arrival,
+                          ((seed != 0 ? seed : (unsigned long)rd()) << 16) ^ threadNum);
+    TraceCursor cursor(trace.get(), threadNum);
+    HotColdStats keys;
+    for (long i = 0; i < iter; i++) {
+        long due = arrivals.next();
+        const TraceOp o = cursor.replaying() ? cursor.next() : generateOp();
+        bool hot = (o.flags & TRACE_HOT) != 0;
+        if (o.kind == TRACE_CONTAINS) {
+            containsQueue.push(ContainsRequest{o.a, due, hot});
+            continue;
+        }
+        if (o.kind == TRACE_ADD) {
+            list.add(o.a);
+            completed(threadNum, ADD, due);
+            continue;
+        }
+        if (o.kind == TRACE_SET) {
+            list.set(o.a, o.b);
+            completed(threadNum, SET, due);
+        } else {
+            list.get(o.a);
+            completed(threadNum, GET, due);
+        }
+        completed(threadNum, hot ? HOT_INDEX : COLD_INDEX, due);
+        keys.ops[hot]++;
+    }
+    indexStats[threadNum] = keys;
+    finish(threadNum, begin, iter);
+}
+
+inline void ListBench::do_workContains(int threadNum) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    std::vector<ContainsRequest> vals(containsBatch);
+    long served = 0;
+    HotColdStats keys;
+    while (true) {
+        int n = containsQueue.popBatch(vals.data(), containsBatch);
+        for (int v = 0; v < n; v++) {
+            if (scanPool) {
+                list.contains(vals[v].value, *scanPool);
+            } else {
+                list.contains(vals[v].value);
+            }
+            completed(threadNum, CONTAINS, vals[v].due); // includes the time spent queued
+            completed(threadNum, vals[v].hot ? HOT_CONTAINS : COLD_CONTAINS, vals[v].due);
+            keys.ops[vals[v].hot]++;
+        }
+        served += n;
+        if (n == 0) { // closed and drained
+            valueStats[threadNum] = keys;
+            finish(threadNum, begin, served);
+            return;
+        }
+    }
+}
+
+inline void ListBench::do_workSynch(ArrayList<int>& seqList, int threadNum, long iter) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    bool hot;
+    for (long i = 0; i < iter; i++) {
+        int num = generateRandomInt(1, 100);
+        if (num <= containsPer) {
+            seqList.contains(generateRandomVal(hot));
+        } else if (num <= addsPer) {
+            seqList.add(generateRandomVal(hot));
+        } else {
+            seqList.get(generateRandomIndex(hot));
+        }
+    }
+    finish(threadNum, begin, iter);
+}
+
+// Times full scans (the value is never in the list) on one thread and split
+// across the scan pool, with nothing else running
+inline void ListBench::probeScan(Record& rec) {
+    using namespace std::chrono;
+    long probes = std::max(1L, cfg.getInt("scanprobe"));
+    double ns[2];
+    for (int split = 0; split < 2; split++) {
+        steady_clock::time_point start = steady_clock::now();
+        for (long p = 0; p < probes; p++) {
+            if (split) {
+                list.contains(-1, *scanPool);
+            } else {
+                list.contains(-1);
+            }
+        }
+        ns[split] = (double)duration_cast<nanoseconds>(steady_clock::now() - start).count() / probes;
+    }
+    printf("Scan of %d elements: %.0lf ns on one thread, %.0lf ns on %d, speedup %.2lf; %ld of the run's contains "
+           "parts skipped after a match\n", list.size(), ns[0], ns[1], scanPool->workers() + 1, ns[0] / ns[1],
+           scanPool->cancelled());
+    rec.add("scan_serial_ns", ns[0]);
+    rec.add("scan_parallel_ns", ns[1]);
+    rec.add("scan_speedup", ns[0] / ns[1]);
+    rec.add("scan_parts_skipped", scanPool->cancelled());
+}
+
+inline bool ListBench::run(Record& rec) {
+    int producers = threads - containsThreads;
+    std::vector<std::thread> workers(threads);
+    long iter = iterations / threads;
+    placement.plan(producers, containsThreads, 0);
+    if(!cfg.getString("trace").empty()){
+        loadTrace(producers, iter, rec);
+    }
+    if(cfg.getString("migrate") != "0"){
+        std::cout << "Migration follows account lock contention, the list workload stays static" << std::endl;
+    }
+    std::cout << "Placement " << placement.describe() << ", " << searchKernelName(searchKernel()) << " search"
+              << std::endl;
+    sampler.beginPhase("parallel");
+    for(int i = producers; i < threads; i++){
+        workers[i] = placement.spawn(READER, i - producers, [this, i] { do_workContains(i); });
+    }
+    for(int i = 0; i < producers; i++){
+        workers[i] = placement.spawn(WRITER, i, [this, i, iter] { do_work(i, iter); });
+    }
+
+    for(int i = 0; i < producers; i++){
+        workers[i].join();
+    }
+    containsQueue.close();
+    for(int i = producers; i < threads; i++){
+        workers[i].join();
+    }
+    long produced = 0;
+    long containsServed = 0;
+    for(int i = 0; i < threads; i++){
+        (i < producers ? produced : containsServed) += stats[i].ops;
+    }
+    sampler.endPhase(produced);
+
+    double maxTime = 0.0;
+    for(int i = 0; i < threads; i++){
+        maxTime = std::max(maxTime, stats[i].time);
+    }
+    printf("Total Parallel %d Threaded time: %lf seconds\n", threads, maxTime);
+    std::cout << "LEFT: " << containsQueue.size() << std::endl;
+    rec.add("misplaced_threads", placement.misplaced());
+    rec.add("search_kernel", searchKernelName(searchKernel()));
+    rec.add("time_s", maxTime);
+    rec.add("operations", produced);
+    rec.add("contains_served", containsServed);
+    if(appends > 0){
+        std::cout << "List grew to " << list.size() << " elements in " << list.segments() << " segments" << std::endl;
+    }
+    rec.add("list_size", list.size());
+    if(ValueIndex<int>* index = list.valueIndex()){
+        std::cout << "Value index: " << index->distinct() << " distinct values in " << index->bytes() / 1024
+                  << " KiB, " << index->updates() << " updates" << std::endl;
+        rec.add("index_distinct", index->distinct());
+        rec.add("index_bytes", index->bytes());
+        rec.add("index_updates", index->updates());
+    }
+    if(list.optimistic()){
+        std::cout << "Seqlock stripes: " << list.retries() << " optimistic reads retried" << std::endl;
+        rec.add("seqlock_retries", list.retries());
+    }
+    rec.add("throughput", maxTime > 0 ? produced / maxTime : 0.0);
+    if(indexKeys.skewed() || valueKeys.skewed()){
+        HotColdStats indexes, values;
+        for(int i = 0; i < threads; i++){
+            indexes.add(indexStats[i]);
+            values.add(valueStats[i]);
+        }
+        indexes.report("indexes", indexKeys.hotCount(), size, rec);
+        values.report("values", valueKeys.hotCount(), size, rec);
+    }
+    if(rate > 0){
+        rec.add("offered_rate", rate);
+        const char* names[LATENCYOPS] = {"get", "set", "add", "contains", "hot_index", "cold_index", "hot_contains",
+                                         "cold_contains"};
+        for(int type = 0; type < LATENCYOPS; type++){
+            if((type >= HOT_INDEX && !indexKeys.skewed() && !valueKeys.skewed()) || (type == ADD && appends == 0)){
+                continue;
+            }
+            LatencyHistogram merged;
+            for(int i = 0; i < threads; i++){
+                merged.add(latency[i * LATENCYOPS + type]);
+            }
+            merged.report(names[type], rec);
+        }
+    }
+    if(scanPool && !list.valueIndex()){ // with the index contains does not scan
+        probeScan(rec);
+    }
+    if(cfg.getInt("lockprofile") != 0){
+        profiler.report(std::cout, cfg.getInt("locktop"));
+        rec.add("lock_acquisitions", profiler.acquisitions());
+        rec.add("lock_contended", profiler.contended());
+        rec.add("lock_wait_ns", profiler.waitNs());
+        rec.add("hottest_lock", profiler.hottest());
+        std::string lockFile = cfg.getString("lockprofilefile");
+        if(!lockFile.empty() && !profiler.writeCsv(lockFile)){
+            std::cerr << "Cannot write lock profile " << lockFile << std::endl;
+        }
+    }
+
+    if(cfg.getInt("sequential") != 0){
+        ArrayList<int> seqList(size);
+        sampler.beginPhase("sequential");
+        do_workSynch(seqList, 0, iterations);
+        sampler.endPhase(iterations);
+        printf("Total Sequential time: %lf seconds\n", stats[0].time);
+        rec.add("sequential_time_s", stats[0].time);
+    }
+    return containsQueue.size() == 0;
+}
@@ -0,0 +1,260 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+// Acquisition count, contended acquisitions and log2 wait / hold time
+// histograms of one lock. Exclusive holders update the counters while they
+// own the lock, so those updates are plain relaxed stores; shared holders run
+// concurrently and add atomically.
+struct alignas(64) LockStats {
+    static const int BUCKETS = 32; // bucket k counts [2^k, 2^(k+1)) ns, the last also everything above
+    static const long CONTENDEDNS = 1000; // an acquisition that waited longer was contended
+
+    std::atomic<long> acquisitions{0};
+    std::atomic<long> contended{0};
+    std::atomic<long> waitNs{0};
+    std::atomic<long> holdNs{0};
+    std::atomic<long> maxWaitNs{0};
+    std::atomic<long> maxHoldNs{0};
+    long heldSince = 0; // exclusive owner only
+    alignas(64) std::atomic<long> wait[BUCKETS] = {};
+    alignas(64) std::atomic<long> hold[BUCKETS] = {};
+
+    static int bucket(long ns);
+    static long now();
+    void acquired(long waited, bool exclusive);
+    void released(long held, bool exclusive);
+    long percentile(const std::atomic<long>* hist, double p) const;
+};
+
+inline int LockStats::bucket(long ns) {
+    int b = 63 - __builtin_clzll((unsigned long long)ns | 1);
+    return b < BUCKETS ? b : BUCKETS - 1;
+}
+
+inline long LockStats::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void bumpStat(std::atomic<long>& v, long by, bool exclusive) {
+    if (exclusive) {
+        v.store(v.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    } else {
+        v.fetch_add(by, std::memory_order_relaxed);
+    }
+}
+
+inline void raiseStat(std::atomic<long>& v, long to) {
+    long seen = v.load(std::memory_order_relaxed);
+    while (to > seen && !v.compare_exchange_weak(seen, to, std::memory_order_relaxed)) {
+    }
+}
+
+inline void LockStats::acquired(long waited, bool exclusive) {
+    bumpStat(acquisitions, 1, exclusive);
+    if (waited > CONTENDEDNS) {
+        bumpStat(contended, 1, exclusive);
+    }
+    bumpStat(waitNs, waited, exclusive);
+    bumpStat(wait[bucket(waited)], 1, exclusive);
+    raiseStat(maxWaitNs, waited);
+}
+
+inline void LockStats::released(long held, bool exclusive) {
+    bumpStat(holdNs, held, exclusive);
+    bumpStat(hold[bucket(held)], 1, exclusive);
+    raiseStat(maxHoldNs, held);
+}
+
+// Upper bound of the bucket holding the p-th quantile, so within a factor of 2
+inline long LockStats::percentile(const std::atomic<long>* hist, double p) const {
+    long total = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        total += hist[b].load(std::memory_order_relaxed);
+    }
+    long rank = (long)(p * total);
+    long seen = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        seen += hist[b].load(std::memory_order_relaxed);
+        if (seen > rank) {
+            return 2L << b;
+        }
+    }
+    return 0;
+}
+
+// Timed acquire / release of any BasicLockable (and of the shared side of a
+// SharedLockable). The lock is untouched apart from the clock reads around
+// it, so the policy under test behaves as it does unprofiled.
+template <typename L>
+void profiledLock(L& l, LockStats& s) {
+    long start = LockStats::now();
+    l.lock();
+    long got = LockStats::now();
+    s.heldSince = got;
+    s.acquired(got - start, true);
+}
+
+template <typename L>
+void profiledUnlock(L& l, LockStats& s) {
+    s.released(LockStats::now() - s.heldSince, true);
+    l.unlock();
+}
+
+// Shared holders overlap, each keeps its own acquire time
+template <typename L>
+long profiledLockShared(L& l, LockStats& s) {
+    long start = LockStats::now();
+    l.lock_shared();
+    long got = LockStats::now();
+    s.acquired(got - start, false);
+    return got;
+}
+
+template <typename L>
+void profiledUnlockShared(L& l, LockStats& s, long since) {
+    s.released(LockStats::now() - since, false);
+    l.unlock_shared();
+}
+
+// Named groups of LockStats, one entry per lock of an array (account locks,
+// thread locks, list stripes), with a hot-lock report and CSV export.
+class LockProfiler {
+public:
+    LockStats* group(const std::string& name, int count);
+    long acquisitions() const;
+    long contended() const;
+    long waitNs() const;
+    std::string hottest() const;
+    void report(std::ostream& out, int top) const;
+    bool writeCsv(const std::string& path) const;
+
+private:
+    struct Group {
+        std::string name;
+        int count;
+        std::unique_ptr<LockStats[]> stats;
+    };
+    struct Entry {
+        const Group* group;
+        int index;
+        const LockStats* stats;
+    };
+
+    std::vector<Group> groups;
+
+    std::vector<Entry> ranked() const; // used locks, most total wait first
+    static std::string label(const Entry& e);
+};
+
+inline LockStats* LockProfiler::group(const std::string& name, int count) {
+    groups.push_back(Group{name, count, std::unique_ptr<LockStats[]>(new LockStats[count])});
+    return groups.back().stats.get();
+}
+
+inline std::vector<LockProfiler::Entry> LockProfiler::ranked() const {
+    std::vector<Entry> entries;
+    for (const Group& g : groups) {
+        for (int i = 0; i < g.count; i++) {
+            if (g.stats[i].acquisitions.load() > 0) {
+                entries.push_back(Entry{&g, i, &g.stats[i]});
+            }
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.stats->waitNs.load() > b.stats->waitNs.load();
+    });
+    return entries;
+}
+
+inline std::string LockProfiler::label(const Entry& e) {
+    return e.group->name + "[" + std::to_string(e.index) + "]";
+}
+
+inline long LockProfiler::acquisitions() const {
+    long total = 0;
+    for (const Entry& e : ranked()) {
+        total += e.stats->acquisitions.load();
+    }
+    return total;
+}
+
+inline long LockProfiler::contended() const {
+    long total = 0;
+    for (const Entry& e : ranked()) {
+        total += e.stats->contended.load();
+    }
+    return total;
+}
+
+inline long LockProfiler::waitNs() const {
+    long total = 0;
+    for (const Entry& e : ranked()) {
+        total += e.stats->waitNs.load();
+    }
+    return total;
+}
+
+// the lock with the most total wait, empty if nothing was taken
+inline std::string LockProfiler::hottest() const {
+    std::vector<Entry> entries = ranked();
+    return entries.empty() ? "" : label(entries[0]);
+}
+
+// e.g. "account[17]: 5120 acquisitions, 31.2% contended, wait 812 us total,
+//       p50 64 ns p99 16384 ns max 20312 ns, hold p50 256 ns p99 1024 ns"
+inline void LockProfiler::report(std::ostream& out, int top) const {
+    std::vector<Entry> entries = ranked();
+    out << "Lock profile: " << entries.size() << " locks used, " << acquisitions() << " acquisitions, "
+        << contended() << " contended, " << waitNs() / 1000 << " us waiting" << std::endl;
+    for (int i = 0; i < top && i < (int)entries.size(); i++) {
+        const LockStats& s = *entries[i].stats;
+        long n = s.acquisitions.load();
+        std::ostringstream line;
+        line.precision(3);
+        line << "  " << label(entries[i]) << ": " << n << " acquisitions, "
+             << 100.0 * s.contended.load() / n << "% contended, wait " << s.waitNs.load() / 1000 << " us total, p50 "
+             << s.percentile(s.wait, 0.5) << " ns p99 " << s.percentile(s.wait, 0.99) << " ns max "
+             << s.maxWaitNs.load() << " ns, hold p50 " << s.percentile(s.hold, 0.5) << " ns p99 "
+             << s.percentile(s.hold, 0.99) << " ns";
+        out << line.str() << std::endl;
+    }
+}
+
+// One row per lock that was taken, hottest first, with both histograms;
+// bucket columns are named by their exclusive upper bound
+inline bool LockProfiler::writeCsv(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        return false;
+    }
+    out << "lock,group,index,acquisitions,contended,wait_ns,hold_ns,wait_p50_ns,wait_p99_ns,wait_max_ns,"
+        << "hold_p50_ns,hold_p99_ns,hold_max_ns";
+    for (const char* kind : {"wait", "hold"}) {
+        for (int b = 0; b < LockStats::BUCKETS; b++) {
+            out << "," << kind << "_lt_" << (b + 1 < LockStats::BUCKETS ? std::to_string(2L << b) : "inf") << "ns";
+        }
+    }
+    out << std::endl;
+    for (const Entry& e : ranked()) {
+        const LockStats& s = *e.stats;
+        out << label(e) << "," << e.group->name << "," << e.index << "," << s.acquisitions.load() << ","
+            << s.contended.load() << "," << s.waitNs.load() << "," << s.holdNs.load() << ","
+            << s.percentile(s.wait, 0.5) << "," << s.percentile(s.wait, 0.99) << "," << s.maxWaitNs.load() << ","
+            << s.percentile(s.hold, 0.5) << "," << s.percentile(s.hold, 0.99) << "," << s.maxHoldNs.load();
+        for (const std::atomic<long>* hist : {s.wait, s.hold}) {
+            for (int b = 0; b < LockStats::BUCKETS; b++) {
+                out << "," << hist[b].load();
+            }
+        }
+        out << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,532 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Lock policies for the account locks. Every policy is BasicLockable
+// (lock/unlock) so it drops into std::lock_guard / std::unique_lock wherever
+// std::mutex was used. CLH has no try_lock: a recycled tail node makes the
+// check-then-swap racy. The spinning policies are cache-line aligned
+// so neighbouring locks in an array do not false-share.
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+inline void futexWait(std::atomic<int>* addr, int expected) {
+    syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+inline void futexWake(std::atomic<int>* addr, int count) {
+    syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+// Test-and-test-and-set with bounded exponential backoff
+class alignas(64) TTASLock {
+public:
+    void lock() {
+        int backoff = 1;
+        while (true) {
+            while (held.load(std::memory_order_relaxed)) {
+                cpuRelax();
+            }
+            if (!held.exchange(true, std::memory_order_acquire)) {
+                return;
+            }
+            for (int i = 0; i < backoff; i++) {
+                cpuRelax();
+            }
+            backoff = backoff < MAXBACKOFF ? backoff * 2 : MAXBACKOFF;
+        }
+    }
+    bool try_lock() {
+        return !held.load(std::memory_order_relaxed) && !held.exchange(true, std::memory_order_acquire);
+    }
+    void unlock() {
+        held.store(false, std::memory_order_release);
+    }
+
+private:
+    static const int MAXBACKOFF = 1024;
+    std::atomic<bool> held{false};
+};
+
+// FIFO ticket lock with backoff proportional to our distance from the head
+class alignas(64) TicketLock {
+public:
+    void lock() {
+        unsigned int ticket = next.fetch_add(1, std::memory_order_relaxed);
+        while (true) {
+            unsigned int cur = serving.load(std::memory_order_acquire);
+            if (cur == ticket) {
+                return;
+            }
+            for (unsigned int i = 0; i < (ticket - cur) * BACKOFF; i++) {
+                cpuRelax();
+            }
+        }
+    }
+    bool try_lock() {
+        unsigned int cur = serving.load(std::memory_order_relaxed);
+        unsigned int expected = cur;
+        return next.compare_exchange_strong(expected, cur + 1, std::memory_order_acquire);
+    }
+    void unlock() {
+        serving.store(serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    static const unsigned int BACKOFF = 32;
+    std::atomic<unsigned int> next{0};
+    std::atomic<unsigned int> serving{0};
+};
+
+// Queue node shared by the MCS and CLH locks. Nodes are recycled through a
+// per-thread pool; a thread can hold several queue locks at once (thread
+// lock plus two account locks, or a whole batch), so one node per thread is
+// not enough.
+struct alignas(64) QNode {
+    std::atomic<QNode*> next{nullptr};
+    std::atomic<bool> locked{false};
+};
+
+class QNodePool {
+public:
+    static QNode* get() {
+        std::vector<QNode*>& nodes = pool().free;
+        if (nodes.empty()) {
+            return new QNode();
+        }
+        QNode* n = nodes.back();
+        nodes.pop_back();
+        return n;
+    }
+    static void put(QNode* n) {
+        pool().free.push_back(n);
+    }
+
+private:
+    struct Pool {
+        std::vector<QNode*> free;
+        ~Pool() {
+            for (QNode* n : free) {
+                delete n;
+            }
+        }
+    };
+    static Pool& pool() {
+        thread_local Pool p;
+        return p;
+    }
+};
+
+// Mellor-Crummey/Scott queue lock: each waiter spins on its own node
+class alignas(64) MCSLock {
+public:
+    void lock() {
+        QNode* n = QNodePool::get();
+        n->next.store(nullptr, std::memory_order_relaxed);
+        n->locked.store(true, std::memory_order_relaxed);
+        QNode* pred = tail.exchange(n, std::memory_order_acq_rel);
+        if (pred != nullptr) {
+            pred->next.store(n, std::memory_order_release);
+            while (n->locked.load(std::memory_order_acquire)) {
+                cpuRelax();
+            }
+        }
+        holder = n;
+    }
+    bool try_lock() {
+        QNode* n = QNodePool::get();
+        n->next.store(nullptr, std::memory_order_relaxed);
+        QNode* expected = nullptr;
+        if (tail.compare_exchange_strong(expected, n, std::memory_order_acq_rel)) {
+            holder = n;
+            return true;
+        }
+        QNodePool::put(n);
+        return false;
+    }
+    void unlock() {
+        QNode* n = holder;
+        QNode* succ = n->next.load(std::memory_order_acquire);
+        if (succ == nullptr) {
+            QNode* expected = n;
+            if (tail.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+                QNodePool::put(n);
+                return;
+            }
+            // a successor swapped itself in but has not linked yet
+            while ((succ = n->next.load(std::memory_order_acquire)) == nullptr) {
+                cpuRelax();
+            }
+        }
+        succ->locked.store(false, std::memory_order_release);
+        QNodePool::put(n);
+    }
+
+private:
+    std::atomic<QNode*> tail{nullptr};
+    QNode* holder = nullptr; // only touched by the current owner
+};
+
+// Craig/Landin/Hagersten queue lock: each waiter spins on its predecessor's
+// node and inherits that node when it releases
+class alignas(64) CLHLock {
+public:
+    CLHLock() {
+        tail.store(new QNode(), std::memory_order_relaxed);
+    }
+    ~CLHLock() {
+        delete tail.load(std::memory_order_relaxed);
+    }
+    CLHLock(const CLHLock&) = delete;
+    CLHLock& operator=(const CLHLock&) = delete;
+
+    void lock() {
+        QNode* n = QNodePool::get();
+        n->locked.store(true, std::memory_order_relaxed);
+        QNode* pred = tail.exchange(n, std::memory_order_acq_rel);
+        while (pred->locked.load(std::memory_order_acquire)) {
+            cpuRelax();
+        }
+        holder = n;
+        holderPred = pred;
+    }
+    void unlock() {
+        QNode* n = holder;
+        QNode* pred = holderPred;
+        n->locked.store(false, std::memory_order_release);
+        QNodePool::put(pred); // nobody else can reference it any more
+    }
+
+private:
+    std::atomic<QNode*> tail;
+    QNode* holder = nullptr;
+    QNode* holderPred = nullptr;
+};
+
+// Spin briefly, then park on a futex (0 free, 1 held, 2 held with sleepers)
+class alignas(64) FutexLock {
+public:
+    void lock() {
+        for (int i = 0; i < SPINS; i++) {
+            if (state.load(std::memory_order_relaxed) == 0 && try_lock()) {
+                return;
+            }
+            cpuRelax();
+        }
+        int c = state.exchange(2, std::memory_order_acquire);
+        while (c != 0) {
+            futexWait(&state, 2);
+            c = state.exchange(2, std::memory_order_acquire);
+        }
+    }
+    bool try_lock() {
+        int expected = 0;
+        return state.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+    }
+    void unlock() {
+        if (state.exchange(0, std::memory_order_release) == 2) {
+            futexWake(&state, 1);
+        }
+    }
+
+private:
+    static const int SPINS = 128;
+    std::atomic<int> state{0};
+};
+
+// Shared tuning state for AdaptiveLock. Locks report contended waits and
+// sampled hold times; a tuner thread periodically reads the energy counter
+// and hill-climbs the spin budget (in ns) toward the lowest energy per
+// acquisition while the mean contended wait stays under the target latency.
+// Without an energy reading, time spent spinning stands in for energy.
+class SpinTuner {
+public:
+    SpinTuner() {
+        stopping = false;
+        reset();
+    }
+    ~SpinTuner() {
+        stop();
+    }
+
+    long budget() {
+        return budgetNs.load(std::memory_order_relaxed);
+    }
+    long holdEstimate() {
+        return holdEwmaNs.load(std::memory_order_relaxed);
+    }
+    void countAcquire() {
+        slot().acquisitions.fetch_add(1, std::memory_order_relaxed);
+    }
+    void recordWait(long waitNs, long spinNs, bool parked) {
+        Counters& c = slot();
+        c.contended.fetch_add(1, std::memory_order_relaxed);
+        c.waitNs.fetch_add(waitNs, std::memory_order_relaxed);
+        c.spinNs.fetch_add(spinNs, std::memory_order_relaxed);
+        if (parked) {
+            c.parks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    void recordHold(long holdNs) {
+        // racy EWMA (alpha 1/8) is fine, it only steers the spin decision
+        long old = holdEwmaNs.load(std::memory_order_relaxed);
+        holdEwmaNs.store(old + (holdNs - old) / 8, std::memory_order_relaxed);
+    }
+
+    // Back to the initial budget with every counter zeroed. The tuner is one
+    // per process, so each run starts here rather than where the last ended.
+    void reset() {
+        budgetNs = 4000; // roughly one futex park/wake round trip
+        holdEwmaNs = 0;
+        direction = 1;
+        lastCost = -1.0;
+        lastEnergy = 0.0;
+        lastAcquisitions = lastContended = lastWaitNs = lastSpinNs = 0;
+        for (int i = 0; i < SLOTS; i++) {
+            counters[i].acquisitions = 0;
+            counters[i].contended = 0;
+            counters[i].waitNs = 0;
+            counters[i].spinNs = 0;
+            counters[i].parks = 0;
+        }
+    }
+
+    // energy returns cumulative joules (0 if unavailable); resets first
+    void start(std::function<double()> _energy, long _targetLatencyNs, std::chrono::milliseconds interval) {
+        stop();
+        reset();
+        energy = _energy;
+        targetLatencyNs = _targetLatencyNs;
+        lastEnergy = energy();
+        stopping = false;
+        tuner = std::thread([this, interval] {
+            std::unique_lock<std::mutex> lock(tunerMutex);
+            while (!tunerCV.wait_for(lock, interval, [this] { return stopping; })) {
+                adjust();
+            }
+        });
+    }
+    void stop() {
+        if (!tuner.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(tunerMutex);
+            stopping = true;
+        }
+        tunerCV.notify_all();
+        tuner.join();
+    }
+
+    long acquisitions() {
+        return sum(&Counters::acquisitions);
+    }
+    long parks() {
+        return sum(&Counters::parks);
+    }
+
+private:
+    static const long MAXBUDGETNS = 128000;
+    static const int SLOTS = 64;
+    struct alignas(64) Counters {
+        std::atomic<long> acquisitions{0};
+        std::atomic<long> contended{0};
+        std::atomic<long> waitNs{0};
+        std::atomic<long> spinNs{0};
+        std::atomic<long> parks{0};
+    };
+
+    std::atomic<long> budgetNs;
+    std::atomic<long> holdEwmaNs;
+    Counters counters[SLOTS];
+    std::function<double()> energy;
+    long targetLatencyNs;
+
+    // tuner thread state
+    int direction;
+    double lastCost;
+    double lastEnergy;
+    long lastAcquisitions = 0, lastContended = 0, lastWaitNs = 0, lastSpinNs = 0;
+    std::thread tuner;
+    std::mutex tunerMutex;
+    std::condition_variable tunerCV;
+    bool stopping;
+
+    Counters& slot() {
+        static std::atomic<int> nextSlot{0};
+        thread_local int mine = nextSlot.fetch_add(1) % SLOTS;
+        return counters[mine];
+    }
+    long sum(std::atomic<long> Counters::*field) {
+        long total = 0;
+        for (int i = 0; i < SLOTS; i++) {
+            total += (counters[i].*field).load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    void adjust() {
+        long acq = sum(&Counters::acquisitions);
+        long contended = sum(&Counters::contended);
+        long waitNs = sum(&Counters::waitNs);
+        long spinNs = sum(&Counters::spinNs);
+        double joules = energy();
+        long dAcq = acq - lastAcquisitions;
+        long dContended = contended - lastContended;
+        double dJoules = joules - lastEnergy;
+        long dWaitNs = waitNs - lastWaitNs;
+        long dSpinNs = spinNs - lastSpinNs;
+        lastAcquisitions = acq;
+        lastContended = contended;
+        lastWaitNs = waitNs;
+        lastSpinNs = spinNs;
+        lastEnergy = joules;
+        if (dAcq == 0) {
+            return;
+        }
+        double latency = dContended > 0 ? (double)dWaitNs / dContended : 0.0;
+        double cost = dJoules > 0 ? dJoules / dAcq : (double)dSpinNs / dAcq;
+
+        if (latency > targetLatencyNs) {
+            direction = 1; // parking is too slow to meet the target, spin longer
+        } else if (lastCost >= 0 && cost > lastCost) {
+            direction = -direction; // last step made things worse
+        }
+        lastCost = cost;
+        long b = budgetNs.load(std::memory_order_relaxed);
+        b = direction > 0 ? (b < 250 ? 250 : b * 2) : b / 2;
+        budgetNs.store(b > MAXBUDGETNS ? MAXBUDGETNS : b, std::memory_order_relaxed);
+    }
+};
+
+// Spin-then-park lock whose spin budget comes from a SpinTuner. A waiter skips
+// spinning entirely when the waiters ahead of it times the typical hold time
+// already exceed the budget.
+class alignas(64) AdaptiveLock {
+public:
+    static SpinTuner& tuner() {
+        static SpinTuner t;
+        return t;
+    }
+
+    void lock() {
+        SpinTuner& t = tuner();
+        t.countAcquire();
+        if (try_lock()) {
+            sampleHold();
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        long budget = t.budget();
+        int ahead = waiters.fetch_add(1, std::memory_order_relaxed) + 1;
+        long spun = 0;
+        bool acquired = false;
+        if (ahead * t.holdEstimate() <= budget) {
+            for (int i = 1; ; i++) {
+                if (state.load(std::memory_order_relaxed) == 0 && try_lock()) {
+                    acquired = true;
+                    break;
+                }
+                cpuRelax();
+                if (i % 32 == 0) {
+                    spun = elapsedNs(start);
+                    if (spun >= budget) {
+                        break;
+                    }
+                }
+            }
+        }
+        if (!acquired) {
+            int c = state.exchange(2, std::memory_order_acquire);
+            while (c != 0) {
+                futexWait(&state, 2);
+                c = state.exchange(2, std::memory_order_acquire);
+            }
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        long waited = elapsedNs(start);
+        t.recordWait(waited, acquired ? waited : spun, !acquired);
+        timed = true;
+        acquiredAt = std::chrono::steady_clock::now();
+    }
+    bool try_lock() {
+        int expected = 0;
+        return state.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+    }
+    void unlock() {
+        if (timed) {
+            timed = false;
+            tuner().recordHold(elapsedNs(acquiredAt));
+        }
+        if (state.exchange(0, std::memory_order_release) == 2) {
+            futexWake(&state, 1);
+        }
+    }
+
+private:
+    static const int HOLDSAMPLE = 64; // time 1 in 64 uncontended holds
+    std::atomic<int> state{0};
+    std::atomic<int> waiters{0};
+    bool timed = false; // owner only
+    std::chrono::steady_clock::time_point acquiredAt;
+
+    static long elapsedNs(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+    }
+    void sampleHold() {
+        thread_local int n = 0;
+        if (++n % HOLDSAMPLE == 0) {
+            timed = true;
+            acquiredAt = std::chrono::steady_clock::now();
+        }
+    }
+};
+
+// Run time selection: calls f(LockPolicy<L>{}) for the lock named name and
+// returns false if the name is unknown
+template <typename L>
+struct LockPolicy {
+    typedef L type;
+};
+
+inline const char* lockPolicyNames() {
+    return "mutex, ttas, ticket, mcs, clh, futex, adaptive";
+}
+
+template <typename F>
+bool withLockPolicy(const std::string& name, F&& f) {
+    if (name == "mutex") {
+        f(LockPolicy<std::mutex>{});
+    } else if (name == "ttas") {
+        f(LockPolicy<TTASLock>{});
+    } else if (name == "ticket") {
+        f(LockPolicy<TicketLock>{});
+    } else if (name == "mcs") {
+        f(LockPolicy<MCSLock>{});
+    } else if (name == "clh") {
+        f(LockPolicy<CLHLock>{});
+    } else if (name == "futex") {
+        f(LockPolicy<FutexLock>{});
+    } else if (name == "adaptive") {
+        f(LockPolicy<AdaptiveLock>{});
+    } else {
+        return false;
+    }
+    return true;
+}
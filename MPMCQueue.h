@@ -0,0 +1,164 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <climits>
+#include <stdexcept>
+#include "Locks.h"
+
+// Bounded lock-free multi-producer/multi-consumer ring (Vyukov's sequence
+// number design). Producers never take a lock; consumers pop in batches and
+// park on a futex when the ring stays empty. A producer only makes a wake
+// syscall when someone is parked, and then wakes exactly one consumer.
+template <typename T>
+class MPMCQueue {
+public:
+    MPMCQueue(int capacity);
+    bool tryPush(const T& value);
+    void push(const T& value);
+    int tryPopBatch(T* out, int max);
+    int popBatch(T* out, int max);
+    void close();
+    long size();
+
+private:
+    static const int SPINS = 128;
+
+    struct Cell {
+        std::atomic<unsigned long> seq;
+        T value;
+    };
+
+    std::vector<Cell> cells;
+    unsigned long mask;
+    alignas(64) std::atomic<unsigned long> enqueuePos;
+    alignas(64) std::atomic<unsigned long> dequeuePos;
+    alignas(64) std::atomic<int> signal; // futex word, bumped on every wake
+    std::atomic<int> sleepers;
+    std::atomic<bool> closed;
+
+    void wakeOne();
+};
+
+template <typename T>
+MPMCQueue<T>::MPMCQueue(int capacity) : cells(capacity) {
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        throw std::invalid_argument("Capacity must be a power of two");
+    }
+    mask = capacity - 1;
+    for (int i = 0; i < capacity; i++) {
+        cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    enqueuePos.store(0, std::memory_order_relaxed);
+    dequeuePos.store(0, std::memory_order_relaxed);
+    signal.store(0, std::memory_order_relaxed);
+    sleepers.store(0, std::memory_order_relaxed);
+    closed.store(false);
+}
+
+template <typename T>
+bool MPMCQueue<T>::tryPush(const T& value) {
+    unsigned long pos = enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Cell& cell = cells[pos & mask];
+        unsigned long seq = cell.seq.load(std::memory_order_acquire);
+        long diff = (long)seq - (long)pos;
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.value = value;
+                cell.seq.store(pos + 1, std::memory_order_release);
+                wakeOne();
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Blocks (spinning, then yielding) while the ring is full
+template <typename T>
+void MPMCQueue<T>::push(const T& value) {
+    for (int i = 0; !tryPush(value); i++) {
+        if (i < SPINS) {
+            cpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+template <typename T>
+int MPMCQueue<T>::tryPopBatch(T* out, int max) {
+    int n = 0;
+    unsigned long pos = dequeuePos.load(std::memory_order_relaxed);
+    while (n < max) {
+        Cell& cell = cells[pos & mask];
+        unsigned long seq = cell.seq.load(std::memory_order_acquire);
+        long diff = (long)seq - (long)(pos + 1);
+        if (diff == 0) {
+            if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                out[n++] = cell.value;
+                cell.seq.store(pos + mask + 1, std::memory_order_release);
+                pos++;
+            }
+        } else if (diff < 0) {
+            break; // empty
+        } else {
+            pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    return n;
+}
+
+// Returns at least one element, or 0 once the queue is closed and drained
+template <typename T>
+int MPMCQueue<T>::popBatch(T* out, int max) {
+    while (true) {
+        for (int i = 0; i < SPINS; i++) {
+            int n = tryPopBatch(out, max);
+            if (n > 0) {
+                return n;
+            }
+            cpuRelax();
+        }
+        int seen = signal.load(std::memory_order_acquire);
+        sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in wakeOne
+        // re-check after announcing ourselves so a concurrent push cannot be missed
+        int n = tryPopBatch(out, max);
+        if (n > 0 || closed.load()) {
+            sleepers.fetch_sub(1);
+            if (n > 0) {
+                return n;
+            }
+            return tryPopBatch(out, max);
+        }
+        futexWait(&signal, seen);
+        sleepers.fetch_sub(1);
+    }
+}
+
+template <typename T>
+void MPMCQueue<T>::wakeOne() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        signal.fetch_add(1, std::memory_order_release);
+        futexWake(&signal, 1);
+    }
+}
+
+// Wakes every parked consumer; popBatch returns 0 once the ring is drained
+template <typename T>
+void MPMCQueue<T>::close() {
+    closed.store(true);
+    signal.fetch_add(1, std::memory_order_release);
+    futexWake(&signal, INT_MAX);
+}
+
+template <typename T>
+long MPMCQueue<T>::size() {
+    return (long)(enqueuePos.load() - dequeuePos.load());
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include <pthread.h>
+#include <sched.h>
+
+#include "Topology.h"
+
+// What a worker spent on locks, written only by its owner
+struct alignas(64) ThreadActivity {
+    std::atomic<long> waitNs{0}; // acquiring
+    std::atomic<long> holdNs{0}; // inside the critical section
+
+    void add(long wait, long hold) {
+        waitNs.store(waitNs.load(std::memory_order_relaxed) + wait, std::memory_order_relaxed);
+        holdNs.store(holdNs.load(std::memory_order_relaxed) + hold, std::memory_order_relaxed);
+    }
+};
+
+// Moves running threads between the fastest frequency class and the rest
+// according to how they used locks over the last interval. A thread's score
+// is the fraction of the interval it held locks minus the fraction it waited
+// for them: lock holders sit on the critical path and go fast, threads that
+// mostly wait go slow. Hysteresis keeps scores between the demote and promote
+// thresholds where they are, a moved thread stays put for dwell intervals, and
+// a slow thread only displaces a fast one that scores lower by more than the
+// hysteresis band.
+class MigrationController {
+public:
+    MigrationController(const Topology& _topo, int threads, const ThreadActivity* _activity);
+    ~MigrationController();
+
+    bool active() const;
+    void track(int thread, pthread_t handle, int cpu);
+    void release(int thread);
+    void start(std::chrono::milliseconds interval, double _promote, double _demote, int _dwell);
+    void stop();
+    long migrations() const;
+
+private:
+    struct Tracked {
+        bool live = false;
+        pthread_t handle;
+        int cpu = -1;
+        bool fast = false;
+        int sinceMove = 0;
+        long lastWait = 0;
+        long lastHold = 0;
+        double score = 0.0;
+    };
+
+    const Topology& topo;
+    const ThreadActivity* activity;
+    std::vector<int> fastCpus;
+    std::vector<int> slowCpus;
+    std::vector<Tracked> tracked;
+    double promote;
+    double demote;
+    int dwell;
+    std::atomic<long> moves;
+
+    std::mutex m; // guards tracked and running
+    std::condition_variable cv;
+    bool running;
+    std::thread worker;
+
+    void loop(std::chrono::milliseconds interval);
+    void tick(long intervalNs);
+    void move(Tracked& t, bool toFast);
+};
+
+inline MigrationController::MigrationController(const Topology& _topo, int threads, const ThreadActivity* _activity)
+    : topo(_topo), activity(_activity), tracked(threads), promote(0.1), demote(-0.1), dwell(3), running(false) {
+    moves.store(0);
+    for (const CpuInfo& c : topo.cpus()) {
+        (c.freqClass == 0 ? fastCpus : slowCpus).push_back(c.id);
+    }
+}
+
+inline MigrationController::~MigrationController() {
+    stop();
+}
+
+// Nothing to do on a machine with a single frequency class
+inline bool MigrationController::active() const {
+    return !fastCpus.empty() && !slowCpus.empty();
+}
+
+inline void MigrationController::track(int thread, pthread_t handle, int cpu) {
+    std::lock_guard<std::mutex> lock(m);
+    Tracked& t = tracked[thread];
+    t.live = true;
+    t.handle = handle;
+    t.cpu = cpu;
+    t.fast = std::find(fastCpus.begin(), fastCpus.end(), cpu) != fastCpus.end();
+    t.lastWait = activity[thread].waitNs.load(std::memory_order_relaxed);
+    t.lastHold = activity[thread].holdNs.load(std::memory_order_relaxed);
+}
+
+// Must be called before the thread is joined, its handle is dead afterwards
+inline void MigrationController::release(int thread) {
+    std::lock_guard<std::mutex> lock(m);
+    tracked[thread].live = false;
+}
+
+inline void MigrationController::start(std::chrono::milliseconds interval, double _promote, double _demote, int _dwell) {
+    std::lock_guard<std::mutex> lock(m);
+    if (running || !active()) {
+        return;
+    }
+    promote = _promote;
+    demote = _demote;
+    dwell = _dwell;
+    running = true;
+    worker = std::thread(&MigrationController::loop, this, interval);
+}
+
+inline void MigrationController::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        running = false;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+inline long MigrationController::migrations() const {
+    return moves.load();
+}
+
+inline void MigrationController::loop(std::chrono::milliseconds interval) {
+    std::unique_lock<std::mutex> lock(m);
+    while (!cv.wait_for(lock, interval, [this] { return !running; })) {
+        tick(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count());
+    }
+}
+
+// Least crowded CPU of the target class
+inline void MigrationController::move(Tracked& t, bool toFast) {
+    const std::vector<int>& cpus = toFast ? fastCpus : slowCpus;
+    int best = cpus[0];
+    int bestLoad = -1;
+    for (int cpu : cpus) {
+        int load = 0;
+        for (const Tracked& o : tracked) {
+            load += o.live && o.cpu == cpu;
+        }
+        if (bestLoad < 0 || load < bestLoad) {
+            best = cpu;
+            bestLoad = load;
+        }
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(best, &set);
+    if (pthread_setaffinity_np(t.handle, sizeof(set), &set) == 0) {
+        t.cpu = best;
+        t.fast = toFast;
+        t.sinceMove = 0;
+        moves++;
+    }
+}
+
+// called with m held
+inline void MigrationController::tick(long intervalNs) {
+    std::vector<Tracked*> live;
+    int fastUsed = 0;
+    for (size_t i = 0; i < tracked.size(); i++) {
+        Tracked& t = tracked[i];
+        if (!t.live) {
+            continue;
+        }
+        long wait = activity[i].waitNs.load(std::memory_order_relaxed);
+        long hold = activity[i].holdNs.load(std::memory_order_relaxed);
+        t.score = (double)(hold - t.lastHold) / intervalNs - (double)(wait - t.lastWait) / intervalNs;
+        t.lastWait = wait;
+        t.lastHold = hold;
+        t.sinceMove++;
+        live.push_back(&t);
+        fastUsed += t.fast;
+    }
+    std::sort(live.begin(), live.end(), [](const Tracked* a, const Tracked* b) { return a->score > b->score; });
+
+    // mostly waiting: give the fast core back
+    for (Tracked* t : live) {
+        if (t->fast && t->sinceMove >= dwell && t->score < demote) {
+            move(*t, false);
+            fastUsed--;
+        }
+    }
+    // on the critical path: take a free fast core, or the weakest fast thread's
+    int fastSlots = fastCpus.size();
+    for (Tracked* t : live) {
+        if (t->fast || t->sinceMove < dwell || t->score <= promote) {
+            continue;
+        }
+        if (fastUsed >= fastSlots) {
+            Tracked* weakest = nullptr;
+            for (auto it = live.rbegin(); it != live.rend(); ++it) {
+                if ((*it)->fast && (*it)->sinceMove >= dwell) {
+                    weakest = *it;
+                    break;
+                }
+            }
+            if (weakest == nullptr || t->score - weakest->score <= promote - demote) {
+                continue;
+            }
+            move(*weakest, false);
+            fastUsed--;
+        }
+        move(*t, true);
+        fastUsed++;
+    }
+}
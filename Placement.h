@@ -0,0 +1,225 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <pthread.h>
+#include <sched.h>
+
+#include "Topology.h"
+#include "BenchUtil.h"
+
+enum ThreadRole { WRITER, READER, COMBINER };
+
+// Maps benchmark threads to CPUs of the discovered topology by role:
+// writers take locks and transfer, readers audit or serve contains requests,
+// combiners apply delegated transfers. Policies:
+//   split   - readers and combiners on the fastest class, writers on the slowest
+//   spread  - one thread per physical core before any core gets a second
+//   compact - fill both SMT siblings of a core before moving to the next
+//   smtpair - lock holders (writers, combiners) share SMT pairs so lock lines
+//             stay in one core's private caches; readers take the other cores
+//   none    - leave threads to the scheduler
+// More threads than CPUs wrap around the role's list. Each placed thread
+// checks sched_getcpu() once pinned and misplaced() counts the ones that are
+// not where they were sent.
+class Placement {
+public:
+    Placement(const Topology& _topo, const std::string& _policy);
+
+    static std::string policyNames();
+    void plan(int writers, int readers, int combiners);
+    int cpuFor(ThreadRole role, int index) const;
+    template <typename F>
+    std::thread spawn(ThreadRole role, int index, F f);
+    bool pin(pthread_t handle, ThreadRole role, int index);
+    long misplaced() const;
+    std::string describe() const;
+    const Topology& topology() const;
+
+private:
+    const Topology& topo;
+    std::string policy;
+    std::vector<int> assigned[3]; // cpu per thread of each role
+    std::atomic<long> wrong;
+
+    std::vector<int> fastFirst() const;
+    std::vector<int> compactOrder() const;
+    std::vector<int> spreadOrder() const;
+    bool bindSelf(int cpu);
+    static void take(std::vector<int>& out, const std::vector<int>& order, int from, int n);
+};
+
+inline Placement::Placement(const Topology& _topo, const std::string& _policy) : topo(_topo), policy(_policy) {
+    if (policy != "split" && policy != "spread" && policy != "compact" && policy != "smtpair" && policy != "none") {
+        throw std::invalid_argument("Unknown placement " + policy + ", expected one of: " + policyNames());
+    }
+    wrong.store(0);
+}
+
+inline std::string Placement::policyNames() {
+    return "split, spread, compact, smtpair, none";
+}
+
+// fastest class first, ascending ids within a class
+inline std::vector<int> Placement::fastFirst() const {
+    std::vector<CpuInfo> cpus = topo.cpus();
+    std::stable_sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+        return a.freqClass < b.freqClass;
+    });
+    std::vector<int> ids;
+    for (const CpuInfo& c : cpus) {
+        ids.push_back(c.id);
+    }
+    return ids;
+}
+
+// siblings adjacent, cores in package order
+inline std::vector<int> Placement::compactOrder() const {
+    std::vector<CpuInfo> cpus = topo.cpus();
+    std::stable_sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+        if (a.package != b.package) return a.package < b.package;
+        return a.siblings[0] < b.siblings[0];
+    });
+    std::vector<int> ids;
+    for (const CpuInfo& c : cpus) {
+        ids.push_back(c.id);
+    }
+    return ids;
+}
+
+// first sibling of every core, alternating packages, then the second siblings
+inline std::vector<int> Placement::spreadOrder() const {
+    std::vector<CpuInfo> cpus = topo.cpus();
+    auto rank = [](const CpuInfo& c) {
+        return (int)(std::find(c.siblings.begin(), c.siblings.end(), c.id) - c.siblings.begin());
+    };
+    std::stable_sort(cpus.begin(), cpus.end(), [&](const CpuInfo& a, const CpuInfo& b) {
+        if (rank(a) != rank(b)) return rank(a) < rank(b);
+        if (a.core != b.core) return a.core < b.core;
+        return a.package < b.package;
+    });
+    std::vector<int> ids;
+    for (const CpuInfo& c : cpus) {
+        ids.push_back(c.id);
+    }
+    return ids;
+}
+
+inline void Placement::take(std::vector<int>& out, const std::vector<int>& order, int from, int n) {
+    out.clear();
+    for (int i = 0; i < n; i++) {
+        out.push_back(order[(from + i) % order.size()]);
+    }
+}
+
+inline void Placement::plan(int writers, int readers, int combiners) {
+    for (auto& a : assigned) {
+        a.clear();
+    }
+    if (policy == "none") {
+        assigned[WRITER].assign(writers, -1);
+        assigned[READER].assign(readers, -1);
+        assigned[COMBINER].assign(combiners, -1);
+        return;
+    }
+    std::vector<int> order;
+    if (policy == "split") {
+        order = fastFirst();
+        std::vector<int> slowFirst(order.rbegin(), order.rend());
+        take(assigned[COMBINER], order, 0, combiners);
+        take(assigned[READER], order, combiners, readers);
+        take(assigned[WRITER], slowFirst, 0, writers);
+    } else if (policy == "smtpair") {
+        order = compactOrder();
+        std::vector<int> reversed(order.rbegin(), order.rend());
+        take(assigned[COMBINER], order, 0, combiners);
+        take(assigned[WRITER], order, combiners, writers);
+        take(assigned[READER], reversed, 0, readers);
+    } else {
+        order = policy == "spread" ? spreadOrder() : compactOrder();
+        take(assigned[WRITER], order, 0, writers);
+        take(assigned[READER], order, writers, readers);
+        take(assigned[COMBINER], order, writers + readers, combiners);
+    }
+}
+
+// -1 when the thread is left unpinned
+inline int Placement::cpuFor(ThreadRole role, int index) const {
+    const std::vector<int>& cpus = assigned[role];
+    if (index < 0 || index >= (int)cpus.size()) {
+        throw std::out_of_range("No placement planned for thread " + std::to_string(index));
+    }
+    return cpus[index];
+}
+
+inline bool Placement::bindSelf(int cpu) {
+    if (!pinThread(pthread_self(), cpu)) {
+        wrong++;
+        return false;
+    }
+    // setaffinity migrates the caller before it returns
+    int actual = sched_getcpu();
+    if (actual != cpu) {
+        std::cerr << "Thread pinned to CPU " << cpu << " is running on CPU " << actual << std::endl;
+        wrong++;
+        return false;
+    }
+    return true;
+}
+
+// Starts f on a new thread that pins itself first
+template <typename F>
+std::thread Placement::spawn(ThreadRole role, int index, F f) {
+    int cpu = cpuFor(role, index);
+    return std::thread([this, cpu, f]() mutable {
+        if (cpu >= 0) {
+            bindSelf(cpu);
+        }
+        f();
+    });
+}
+
+// For threads started elsewhere; checked by reading the affinity mask back
+inline bool Placement::pin(pthread_t handle, ThreadRole role, int index) {
+    int cpu = cpuFor(role, index);
+    if (cpu < 0) {
+        return true;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (!pinThread(handle, cpu) || pthread_getaffinity_np(handle, sizeof(mask), &mask) != 0 ||
+        CPU_COUNT(&mask) != 1 || !CPU_ISSET(cpu, &mask)) {
+        wrong++;
+        return false;
+    }
+    return true;
+}
+
+inline long Placement::misplaced() const {
+    return wrong.load();
+}
+
+// e.g. "split: writers 15,14 readers 0,1 combiners -"
+inline std::string Placement::describe() const {
+    static const char* roles[3] = {"writers", "readers", "combiners"};
+    std::string out = policy + ":";
+    for (int r = 0; r < 3; r++) {
+        out += std::string(" ") + roles[r] + " ";
+        if (assigned[r].empty()) {
+            out += "-";
+        }
+        for (size_t i = 0; i < assigned[r].size(); i++) {
+            out += (i > 0 ? "," : "") + (assigned[r][i] < 0 ? std::string("any") : std::to_string(assigned[r][i]));
+        }
+    }
+    return out;
+}
+
+inline const Topology& Placement::topology() const {
+    return topo;
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <utility>
+#include <cstdlib>
+
+// One structured result row. Fields keep their insertion order and are written
+// as a single JSON object per line so runs can be appended to one file and
+// loaded with any JSON-lines reader.
+class Record {
+public:
+    void add(const std::string& key, const std::string& value);
+    void add(const std::string& key, const char* value);
+    void add(const std::string& key, double value);
+    void add(const std::string& key, long value);
+    void add(const std::string& key, int value);
+    void add(const std::string& key, bool value);
+    std::string json() const;
+    bool append(const std::string& path) const;
+    const std::vector<std::pair<std::string, std::string>>& fields() const;
+    double number(const std::string& key) const;
+
+private:
+    // values are stored already encoded as JSON
+    std::vector<std::pair<std::string, std::string>> values;
+
+    static std::string quote(const std::string& s);
+    void put(const std::string& key, const std::string& encoded);
+};
+
+inline std::string Record::quote(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if ((unsigned char)c < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+inline void Record::put(const std::string& key, const std::string& encoded) {
+    for (auto& kv : values) {
+        if (kv.first == key) {
+            kv.second = encoded;
+            return;
+        }
+    }
+    values.push_back({key, encoded});
+}
+
+inline void Record::add(const std::string& key, const std::string& value) {
+    put(key, quote(value));
+}
+
+inline void Record::add(const std::string& key, const char* value) {
+    put(key, quote(value));
+}
+
+inline void Record::add(const std::string& key, double value) {
+    std::ostringstream out;
+    out << std::setprecision(9) << value;
+    std::string s = out.str();
+    // JSON has no nan/inf
+    put(key, (s.find("nan") != std::string::npos || s.find("inf") != std::string::npos) ? "null" : s);
+}
+
+inline void Record::add(const std::string& key, long value) {
+    put(key, std::to_string(value));
+}
+
+inline void Record::add(const std::string& key, int value) {
+    put(key, std::to_string(value));
+}
+
+inline void Record::add(const std::string& key, bool value) {
+    put(key, value ? "true" : "false");
+}
+
+inline std::string Record::json() const {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) {
+            out += ",";
+        }
+        out += quote(values[i].first) + ":" + values[i].second;
+    }
+    return out + "}";
+}
+
+inline bool Record::append(const std::string& path) const {
+    std::ofstream out(path, std::ios_base::app);
+    if (!out.is_open()) {
+        return false;
+    }
+    out << json() << std::endl;
+    return true;
+}
+
+inline const std::vector<std::pair<std::string, std::string>>& Record::fields() const {
+    return values;
+}
+
+// Numeric value of key, 0 when it is missing or not a number
+inline double Record::number(const std::string& key) const {
+    for (const auto& kv : values) {
+        if (kv.first == key) {
+            return atof(kv.second.c_str());
+        }
+    }
+    return 0.0;
+}
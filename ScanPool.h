@@ -0,0 +1,137 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+// Worker pool for splitting one search into parts. any() queues a job of
+// parts, helps run them on the calling thread and returns whether any part
+// found what it was looking for. The first part that does cancels the job:
+// parts not started yet are skipped, and running ones see the flag they were
+// handed and stop at their next check. Several threads may submit at once;
+// idle workers take parts from the oldest job that has some left.
+class ScanPool {
+public:
+    // part(i, cancelled) searches part i and returns true on a match; it
+    // should give up early once cancelled is set
+    typedef std::function<bool(int, const std::atomic<bool>&)> PartFn;
+
+    ScanPool(int _workers);
+    ~ScanPool();
+    ScanPool(const ScanPool&) = delete;
+    ScanPool& operator=(const ScanPool&) = delete;
+
+    int workers() const;
+    bool any(int parts, const PartFn& part);
+    long jobs() const;
+    long cancelled() const;
+
+private:
+    struct Job {
+        const PartFn* part;
+        int parts;
+        int next = 0; // claimed under the pool mutex by workers, so the job outlives every claim
+        int finished = 0;
+        std::atomic<bool> found{false};
+        std::condition_variable done; // its submitter: the last part finished
+    };
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake; // workers: a job was queued, or stopping
+    std::deque<Job*> queue;
+    bool stopping;
+    std::atomic<long> submitted;
+    std::atomic<long> skipped; // parts never run because the job was already answered
+
+    void work();
+    void runPart(Job& job, int i);
+};
+
+inline ScanPool::ScanPool(int _workers) : stopping(false), submitted(0), skipped(0) {
+    for (int w = 0; w < _workers; w++) {
+        threads.emplace_back(&ScanPool::work, this);
+    }
+}
+
+inline ScanPool::~ScanPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+inline int ScanPool::workers() const {
+    return threads.size();
+}
+
+inline bool ScanPool::any(int parts, const PartFn& part) {
+    submitted++;
+    Job job;
+    job.part = &part;
+    job.parts = parts;
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.push_back(&job);
+    wake.notify_all();
+    while (job.next < job.parts) {
+        int i = job.next++;
+        lock.unlock();
+        runPart(job, i);
+        lock.lock();
+    }
+    auto it = std::find(queue.begin(), queue.end(), &job);
+    if (it != queue.end()) { // a worker may have dropped it already
+        queue.erase(it);
+    }
+    job.done.wait(lock, [&job] { return job.finished == job.parts; });
+    return job.found.load();
+}
+
+inline void ScanPool::runPart(Job& job, int i) {
+    if (job.found.load(std::memory_order_acquire)) {
+        skipped++;
+    } else if ((*job.part)(i, job.found)) {
+        job.found.store(true, std::memory_order_release);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (++job.finished == job.parts) {
+        job.done.notify_one(); // under the mutex: the submitter cannot return and destroy job before this
+    }
+}
+
+inline void ScanPool::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        while (!queue.empty() && queue.front()->next == queue.front()->parts) {
+            queue.pop_front(); // fully claimed; its submitter is only waiting now
+        }
+        if (stopping) {
+            return;
+        }
+        if (queue.empty()) {
+            wake.wait(lock);
+            continue;
+        }
+        Job& job = *queue.front();
+        int i = job.next++;
+        lock.unlock();
+        runPart(job, i);
+        lock.lock();
+    }
+}
+
+inline long ScanPool::jobs() const {
+    return submitted.load();
+}
+
+inline long ScanPool::cancelled() const {
+    return skipped.load();
+}
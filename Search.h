@@ -0,0 +1,201 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEARCH_X86 1
+#endif
+
+// Equality search over a contiguous array: searchIndex() finds the first
+// element equal to value (-1 if none), searchCount() counts them. Arithmetic
+// element types of 1, 2, 4 or 8 bytes are compared a vector at a time with
+// AVX2 or SSE2, picked at run time from what the CPU supports, so the kernels
+// work in a binary built without -mavx2. Floating point keeps the semantics
+// of ==: NaN matches nothing and -0.0 matches 0.0. Other types are scanned
+// one element at a time.
+enum SearchKernel { SEARCH_SCALAR, SEARCH_SSE2, SEARCH_AVX2 };
+
+inline SearchKernel bestSearchKernel() {
+#ifdef SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SEARCH_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SEARCH_SSE2;
+    }
+#endif
+    return SEARCH_SCALAR;
+}
+
+inline SearchKernel searchKernelNamed(const std::string& name) {
+    if (name == "auto") return bestSearchKernel();
+    if (name == "scalar") return SEARCH_SCALAR;
+    if (name == "sse2") return SEARCH_SSE2;
+    if (name == "avx2") return SEARCH_AVX2;
+    throw std::invalid_argument("Unknown search kernel " + name + ", expected auto, scalar, sse2 or avx2");
+}
+
+inline const char* searchKernelName(SearchKernel kernel) {
+    static const char* names[] = {"scalar", "sse2", "avx2"};
+    return names[kernel];
+}
+
+// the kernel in use, the best available unless setSearchKernel() lowered it
+inline std::atomic<int>& activeSearchKernel() {
+    static std::atomic<int> kernel(bestSearchKernel());
+    return kernel;
+}
+
+inline SearchKernel searchKernel() {
+    return (SearchKernel)activeSearchKernel().load(std::memory_order_relaxed);
+}
+
+// Throws std::runtime_error if this CPU cannot run kernel
+inline void setSearchKernel(SearchKernel kernel) {
+    if (kernel > bestSearchKernel()) {
+        throw std::runtime_error(std::string("This CPU has no ") + searchKernelName(kernel) + " search kernel");
+    }
+    activeSearchKernel().store(kernel);
+}
+
+// Types compared a vector at a time
+template <typename T>
+struct SearchVectorizable
+    : std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, long double>::value &&
+                                       (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)> {};
+
+// Scalar loop; countAll counts matches, otherwise returns the first or -1
+template <typename T>
+long searchScalar(const T* data, long n, T value, bool countAll) {
+    long found = 0;
+    for (long i = 0; i < n; i++) {
+        if (data[i] == value) {
+            if (!countAll) {
+                return i;
+            }
+            found++;
+        }
+    }
+    return countAll ? found : -1;
+}
+
+#ifdef SEARCH_X86
+// Lanes equal to needle set to all ones. Each equal element then sets
+// sizeof(T) bits of the byte mask the kernels take from the result.
+template <typename T>
+inline __m128i searchEqual128(__m128i a, __m128i needle) {
+    if constexpr (std::is_same<T, float>::value) {
+        return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(needle)));
+    } else if constexpr (std::is_same<T, double>::value) {
+        return _mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(needle)));
+    } else if constexpr (sizeof(T) == 1) {
+        return _mm_cmpeq_epi8(a, needle);
+    } else if constexpr (sizeof(T) == 2) {
+        return _mm_cmpeq_epi16(a, needle);
+    } else if constexpr (sizeof(T) == 4) {
+        return _mm_cmpeq_epi32(a, needle);
+    } else {
+        // SSE2 has no 64-bit compare: both 32-bit halves must match
+        __m128i halves = _mm_cmpeq_epi32(a, needle);
+        return _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+}
+
+template <typename T>
+long searchSse2(const T* data, long n, T value, bool countAll) {
+    const long lanes = 16 / sizeof(T);
+    alignas(16) T splat[16 / sizeof(T)];
+    for (long l = 0; l < lanes; l++) {
+        splat[l] = value;
+    }
+    __m128i needle = _mm_load_si128((const __m128i*)splat);
+    long i = 0;
+    long found = 0;
+    for (; i + lanes <= n; i += lanes) {
+        unsigned mask = _mm_movemask_epi8(searchEqual128<T>(_mm_loadu_si128((const __m128i*)(data + i)), needle));
+        if (mask != 0) {
+            if (!countAll) {
+                return i + __builtin_ctz(mask) / sizeof(T);
+            }
+            found += __builtin_popcount(mask) / sizeof(T);
+        }
+    }
+    long tail = searchScalar(data + i, n - i, value, countAll);
+    return countAll ? found + tail : (tail < 0 ? -1 : i + tail);
+}
+
+template <typename T>
+__attribute__((target("avx2"))) inline __m256i searchEqual256(__m256i a, __m256i needle) {
+    if constexpr (std::is_same<T, float>::value) {
+        return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(needle), _CMP_EQ_OQ));
+    } else if constexpr (std::is_same<T, double>::value) {
+        return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(needle), _CMP_EQ_OQ));
+    } else if constexpr (sizeof(T) == 1) {
+        return _mm256_cmpeq_epi8(a, needle);
+    } else if constexpr (sizeof(T) == 2) {
+        return _mm256_cmpeq_epi16(a, needle);
+    } else if constexpr (sizeof(T) == 4) {
+        return _mm256_cmpeq_epi32(a, needle);
+    } else {
+        return _mm256_cmpeq_epi64(a, needle);
+    }
+}
+
+// Two vectors per step: one branch covers 64 bytes
+template <typename T>
+__attribute__((target("avx2"))) long searchAvx2(const T* data, long n, T value, bool countAll) {
+    const long lanes = 32 / sizeof(T);
+    alignas(32) T splat[32 / sizeof(T)];
+    for (long l = 0; l < lanes; l++) {
+        splat[l] = value;
+    }
+    __m256i needle = _mm256_load_si256((const __m256i*)splat);
+    long i = 0;
+    long found = 0;
+    for (; i + 2 * lanes <= n; i += 2 * lanes) {
+        unsigned lo = _mm256_movemask_epi8(searchEqual256<T>(_mm256_loadu_si256((const __m256i*)(data + i)), needle));
+        unsigned hi = _mm256_movemask_epi8(
+            searchEqual256<T>(_mm256_loadu_si256((const __m256i*)(data + i + lanes)), needle));
+        if ((lo | hi) != 0) {
+            if (!countAll) {
+                return lo != 0 ? i + __builtin_ctz(lo) / sizeof(T) : i + lanes + __builtin_ctz(hi) / sizeof(T);
+            }
+            found += (__builtin_popcount(lo) + __builtin_popcount(hi)) / sizeof(T);
+        }
+    }
+    long tail = searchSse2(data + i, n - i, value, countAll);
+    return countAll ? found + tail : (tail < 0 ? -1 : i + tail);
+}
+#endif
+
+template <typename T>
+long searchDispatch(const T* data, long n, T value, bool countAll) {
+#ifdef SEARCH_X86
+    if constexpr (SearchVectorizable<T>::value) {
+        switch (searchKernel()) {
+        case SEARCH_AVX2:
+            return searchAvx2(data, n, value, countAll);
+        case SEARCH_SSE2:
+            return searchSse2(data, n, value, countAll);
+        default:
+            break;
+        }
+    }
+#endif
+    return searchScalar(data, n, value, countAll);
+}
+
+template <typename T>
+long searchIndex(const T* data, long n, T value) {
+    return searchDispatch(data, n, value, false);
+}
+
+template <typename T>
+long searchCount(const T* data, long n, T value) {
+    return searchDispatch(data, n, value, true);
+}
@@ -0,0 +1,250 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+#include "Ledger.h"
+#include "Epoch.h"
+
+// Ledger that maintains per-shard running sums next to the accounts, so total
+// and per-shard balances are answered from the shard sums instead of
+// re-reading every account. Accounts are split into contiguous shards; a
+// transfer inside one shard leaves the shard sums untouched, a cross-shard
+// transfer adds into the current epoch's delta of both shards. A query closes
+// the epoch (see EpochDomain) and folds the closed deltas into the base sums,
+// which costs O(shards) plus a check of each writer's announce slot.
+//
+// The running sums only ever move money between shards, so balance() always
+// returns the initial total: it shows the audit's cost, not that the accounts
+// are intact, and unlike Ledger::balance() it cannot detect a lost or
+// corrupted update. recount() is what reads the accounts. A background
+// verifier can periodically pause depositors and recount, counting every
+// shard whose accounts disagree with its running sum.
+template <bool Padded = false>
+class ShardedLedger {
+public:
+    static const bool consistentBalance = true;
+
+    ShardedLedger(int _accounts, long long initial, int _threads, int _shards);
+    ~ShardedLedger();
+    long long get(int acct);
+    void transfer(int threadNum, int from, int to, long long amt);
+    void transferBatch(int threadNum, const Transfer* batch, int n);
+    long long balance();
+    long long shardBalance(int shard);
+    int size();
+    int shardCount();
+    int shardOf(int acct);
+
+    long long recount();
+    void startVerifier(std::chrono::milliseconds interval,
+                       std::function<void()> pause, std::function<void()> resume);
+    void stopVerifier();
+    int verifications();
+    int mismatches();
+
+private:
+    // deltas are indexed by epoch parity; only two epochs are ever open
+    struct alignas(64) Shard {
+        std::atomic<long long> delta[2];
+    };
+
+    int accounts;
+    int shards;
+    int shardSize;
+    Ledger<Padded> data;
+    std::vector<Shard> deltas;
+    std::vector<long long> base; // shard sums as of the last closed epoch
+    EpochDomain epochs;
+    std::mutex auditMutex;
+
+    std::thread verifier;
+    std::mutex verifierMutex;
+    std::condition_variable verifierCV;
+    bool verifierStop;
+    std::atomic<int> verifyCount;
+    std::atomic<int> mismatchCount;
+
+    void fold();
+    int shardStart(int shard);
+};
+
+template <bool Padded>
+ShardedLedger<Padded>::ShardedLedger(int _accounts, long long initial, int _threads, int _shards)
+    : data(_accounts, initial), deltas(_shards > 0 ? _shards : 1), epochs(_threads) {
+    if (_shards <= 0 || _shards > _accounts || _threads <= 0) {
+        throw std::invalid_argument("Invalid shard or thread count");
+    }
+    accounts = _accounts;
+    shards = _shards;
+    shardSize = (accounts + shards - 1) / shards;
+    base.resize(shards);
+    for (int s = 0; s < shards; s++) {
+        base[s] = (long long)(shardStart(s + 1) - shardStart(s)) * initial;
+        deltas[s].delta[0].store(0, std::memory_order_relaxed);
+        deltas[s].delta[1].store(0, std::memory_order_relaxed);
+    }
+    verifierStop = false;
+    verifyCount = 0;
+    mismatchCount = 0;
+}
+
+template <bool Padded>
+ShardedLedger<Padded>::~ShardedLedger() {
+    stopVerifier();
+}
+
+template <bool Padded>
+long long ShardedLedger<Padded>::get(int acct) {
+    return data.get(acct);
+}
+
+template <bool Padded>
+int ShardedLedger<Padded>::size() {
+    return accounts;
+}
+
+template <bool Padded>
+int ShardedLedger<Padded>::shardCount() {
+    return shards;
+}
+
+template <bool Padded>
+int ShardedLedger<Padded>::shardOf(int acct) {
+    return acct / shardSize;
+}
+
+// First account of shard. shardSize is rounded up, so the last shards may
+// start at accounts and hold none.
+template <bool Padded>
+int ShardedLedger<Padded>::shardStart(int shard) {
+    return std::min(shard * shardSize, accounts);
+}
+
+// Caller holds the locks for from and to, same as Ledger::transfer()
+template <bool Padded>
+void ShardedLedger<Padded>::transfer(int threadNum, int from, int to, long long amt) {
+    data.transfer(from, to, amt);
+    int s1 = shardOf(from);
+    int s2 = shardOf(to);
+    if (s1 == s2) {
+        return;
+    }
+    unsigned long long e = epochs.enter(threadNum);
+    deltas[s1].delta[e & 1].fetch_sub(amt, std::memory_order_relaxed);
+    deltas[s2].delta[e & 1].fetch_add(amt, std::memory_order_relaxed);
+    epochs.exit(threadNum);
+}
+
+// Cross-shard legs of the batch all land in one epoch
+template <bool Padded>
+void ShardedLedger<Padded>::transferBatch(int threadNum, const Transfer* batch, int n) {
+    unsigned long long e = epochs.enter(threadNum);
+    for (int i = 0; i < n; i++) {
+        data.transfer(batch[i].from, batch[i].to, batch[i].amt);
+        int s1 = shardOf(batch[i].from);
+        int s2 = shardOf(batch[i].to);
+        if (s1 != s2) {
+            deltas[s1].delta[e & 1].fetch_sub(batch[i].amt, std::memory_order_relaxed);
+            deltas[s2].delta[e & 1].fetch_add(batch[i].amt, std::memory_order_relaxed);
+        }
+    }
+    epochs.exit(threadNum);
+}
+
+// Must hold auditMutex. Writers are already using the other parity by the
+// time close() returns, so the closed parity can be drained without races.
+template <bool Padded>
+void ShardedLedger<Padded>::fold() {
+    unsigned long long snap = epochs.close();
+    for (int s = 0; s < shards; s++) {
+        base[s] += deltas[s].delta[snap & 1].exchange(0, std::memory_order_acq_rel);
+    }
+}
+
+// Sum of the shard sums, the initial total by construction (see above)
+template <bool Padded>
+long long ShardedLedger<Padded>::balance() {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    fold();
+    long long total = 0;
+    for (int s = 0; s < shards; s++) {
+        total += base[s];
+    }
+    return total;
+}
+
+template <bool Padded>
+long long ShardedLedger<Padded>::shardBalance(int shard) {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    fold();
+    return base[shard];
+}
+
+// Full recount of the accounts, counting shards that disagree with their
+// running sums, and their actual total. Only meaningful while depositors are
+// paused.
+template <bool Padded>
+long long ShardedLedger<Padded>::recount() {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    fold();
+    long long total = 0;
+    for (int s = 0; s < shards; s++) {
+        int end = shardStart(s + 1);
+        long long actual = 0;
+        for (int i = shardStart(s); i < end; i++) {
+            actual += data.get(i);
+        }
+        if (actual != base[s]) {
+            mismatchCount++;
+        }
+        total += actual;
+    }
+    verifyCount++;
+    return total;
+}
+
+template <bool Padded>
+void ShardedLedger<Padded>::startVerifier(std::chrono::milliseconds interval,
+                                          std::function<void()> pause, std::function<void()> resume) {
+    stopVerifier();
+    verifierStop = false;
+    verifier = std::thread([this, interval, pause, resume] {
+        std::unique_lock<std::mutex> lock(verifierMutex);
+        while (!verifierCV.wait_for(lock, interval, [this] { return verifierStop; })) {
+            lock.unlock();
+            pause();
+            recount();
+            resume();
+            lock.lock();
+        }
+    });
+}
+
+template <bool Padded>
+void ShardedLedger<Padded>::stopVerifier() {
+    if (!verifier.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(verifierMutex);
+        verifierStop = true;
+    }
+    verifierCV.notify_all();
+    verifier.join();
+}
+
+template <bool Padded>
+int ShardedLedger<Padded>::verifications() {
+    return verifyCount;
+}
+
+template <bool Padded>
+int ShardedLedger<Padded>::mismatches() {
+    return mismatchCount;
+}
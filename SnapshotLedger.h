@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include "Ledger.h"
+#include "Epoch.h"
+
+// Epoch-based snapshot ledger. Every account keeps its current amount plus the
+// amount it had at the end of the previous epoch, so an auditor can close an
+// epoch and sum the closed values while depositors keep committing into the
+// next one. Depositors never wait on an audit; an audit only waits for the
+// transfers that were already in flight when it closed the epoch.
+//
+// Account locks are still the caller's job: transfer() must be called with
+// both accounts locked, exactly like Ledger::transfer().
+class SnapshotLedger {
+public:
+    static const bool consistentBalance = true;
+
+    SnapshotLedger(int _accounts, long long initial, int _threads);
+    long long get(int acct);
+    void transfer(int threadNum, int from, int to, long long amt);
+    void transferBatch(int threadNum, const Transfer* batch, int n);
+    long long balance();
+    int size();
+
+private:
+    struct Account {
+        std::atomic<long long> cur;
+        std::atomic<long long> prev; // value at the end of epoch ver - 1
+        std::atomic<unsigned long long> ver; // epoch of the last write
+    };
+
+    int accounts;
+    std::vector<Account> data;
+    EpochDomain epochs;
+    std::mutex auditMutex; // one snapshot at a time keeps two versions enough
+
+    void write(int acct, long long delta, unsigned long long e);
+};
+
+inline SnapshotLedger::SnapshotLedger(int _accounts, long long initial, int _threads)
+    : data(_accounts), epochs(_threads) {
+    if (_accounts < 0 || _threads <= 0) {
+        throw std::invalid_argument("Invalid account or thread count");
+    }
+    accounts = _accounts;
+    for (int i = 0; i < accounts; i++) {
+        data[i].cur.store(initial, std::memory_order_relaxed);
+        data[i].prev.store(initial, std::memory_order_relaxed);
+        data[i].ver.store(0, std::memory_order_relaxed);
+    }
+}
+
+inline long long SnapshotLedger::get(int acct) {
+    return data[acct].cur.load(std::memory_order_relaxed);
+}
+
+inline int SnapshotLedger::size() {
+    return accounts;
+}
+
+inline void SnapshotLedger::write(int acct, long long delta, unsigned long long e) {
+    Account& a = data[acct];
+    long long cur = a.cur.load(std::memory_order_relaxed);
+    if (a.ver.load(std::memory_order_relaxed) != e) {
+        // first write of this epoch: remember what the closed epoch saw
+        a.prev.store(cur, std::memory_order_relaxed);
+        a.ver.store(e, std::memory_order_release);
+    }
+    a.cur.store(cur + delta, std::memory_order_release);
+}
+
+inline void SnapshotLedger::transfer(int threadNum, int from, int to, long long amt) {
+    unsigned long long e = epochs.enter(threadNum);
+    write(from, -amt, e);
+    write(to, amt, e);
+    epochs.exit(threadNum);
+}
+
+// The whole batch commits into one epoch, so an audit sees all of it or none
+inline void SnapshotLedger::transferBatch(int threadNum, const Transfer* batch, int n) {
+    unsigned long long e = epochs.enter(threadNum);
+    for (int i = 0; i < n; i++) {
+        write(batch[i].from, -batch[i].amt, e);
+        write(batch[i].to, batch[i].amt, e);
+    }
+    epochs.exit(threadNum);
+}
+
+inline long long SnapshotLedger::balance() {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    unsigned long long snap = epochs.close();
+
+    long long total = 0;
+    for (int i = 0; i < accounts; i++) {
+        // cur before ver: if we see a newer cur we are guaranteed to see its ver
+        long long cur = data[i].cur.load(std::memory_order_acquire);
+        unsigned long long ver = data[i].ver.load(std::memory_order_acquire);
+        total += (ver > snap) ? data[i].prev.load(std::memory_order_relaxed) : cur;
+    }
+    return total;
+}
@@ -0,0 +1,329 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Config.h"
+#include "Record.h"
+#include "Bench.h"
+
+// Runs the benchmark over the grid of settings named in sweep=, e.g.
+//   sweep=threads=8,16,28;lock=mutex,mcs;placement=split,spread
+// (axes separated by ';', values by ','), repeat= times per point after
+// warmup= unrecorded runs. All measured runs of all points are shuffled into
+// one schedule so slow drift (thermals, background load) spreads across the
+// grid instead of biasing whichever point ran last; a point's warmups run
+// right before its first measured run. Every measured run is appended to
+// results= as usual, tagged with its point and repetition, and each point is
+// summarized into <sweepout>.csv and <sweepout>.jsonl: mean, standard
+// deviation and 95% confidence half-width of every numeric measurement, plus
+// the energy-delay (J s) and energy-delay-squared (J s^2) products of the
+// parallel phase.
+class Sweep {
+public:
+    Sweep(const Config& _base);
+
+    int points() const;
+    bool run();
+
+private:
+    struct Axis {
+        std::string key;
+        std::vector<std::string> values;
+    };
+    struct Point {
+        std::vector<std::string> values; // one per axis
+        std::vector<Record> runs;
+        int failed = 0; // measured runs that failed
+        int warmupFailed = 0;
+        bool warmed = false;
+    };
+    struct Stats {
+        double mean;
+        double std;
+        double ci95;
+    };
+
+    const Config& base;
+    std::vector<Axis> axes;
+    std::vector<Point> grid;
+    int repeat;
+    int warmup;
+    unsigned long seed;
+
+    Config configFor(const Point& p) const;
+    std::string describe(const Point& p) const;
+    std::vector<std::string> metrics() const;
+    static bool numeric(const std::string& encoded);
+    static Stats stats(const std::vector<double>& xs);
+    static double tQuantile(int df);
+    bool write(const std::string& out) const;
+};
+
+inline Sweep::Sweep(const Config& _base) : base(_base) {
+    repeat = base.getInt("repeat");
+    warmup = base.getInt("warmup");
+    seed = base.getInt("sweepseed");
+    if (repeat < 1 || warmup < 0) {
+        throw std::invalid_argument("Need repeat >= 1 and warmup >= 0");
+    }
+    std::stringstream spec(base.getString("sweep"));
+    std::string axis;
+    while (std::getline(spec, axis, ';')) {
+        if (axis.find_first_not_of(" \t") == std::string::npos) {
+            continue;
+        }
+        size_t eq = axis.find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument("Expected key=v1,v2,... in sweep, got " + axis);
+        }
+        Axis a;
+        a.key = axis.substr(0, eq);
+        if (!base.has(a.key) || a.key == "sweep") {
+            throw std::invalid_argument("Cannot sweep over " + a.key);
+        }
+        std::stringstream values(axis.substr(eq + 1));
+        std::string v;
+        while (std::getline(values, v, ',')) {
+            a.values.push_back(v);
+        }
+        if (a.values.empty()) {
+            throw std::invalid_argument("No values to sweep " + a.key + " over");
+        }
+        axes.push_back(a);
+    }
+    if (axes.empty()) {
+        throw std::invalid_argument("Nothing to sweep");
+    }
+
+    // every combination, last axis varying fastest
+    grid.push_back(Point());
+    for (const Axis& a : axes) {
+        std::vector<Point> next;
+        for (const Point& p : grid) {
+            for (const std::string& v : a.values) {
+                Point q = p;
+                q.values.push_back(v);
+                next.push_back(q);
+            }
+        }
+        grid = next;
+    }
+}
+
+inline int Sweep::points() const {
+    return grid.size();
+}
+
+inline Config Sweep::configFor(const Point& p) const {
+    Config c = base;
+    c.set("sweep", "");
+    for (size_t a = 0; a < axes.size(); a++) {
+        if (!c.set(axes[a].key, p.values[a])) {
+            throw std::invalid_argument("Bad sweep value " + p.values[a] + " for " + axes[a].key);
+        }
+    }
+    c.workloadDefaults();
+    return c;
+}
+
+// e.g. "threads=16 lock=mcs"
+inline std::string Sweep::describe(const Point& p) const {
+    std::string out;
+    for (size_t a = 0; a < axes.size(); a++) {
+        out += (a > 0 ? " " : "") + axes[a].key + "=" + p.values[a];
+    }
+    return out;
+}
+
+inline bool Sweep::run() {
+    if (seed == 0) {
+        std::random_device rd;
+        seed = rd();
+    }
+    std::vector<std::pair<int, int>> schedule; // (point, repetition)
+    for (int p = 0; p < (int)grid.size(); p++) {
+        for (int r = 0; r < repeat; r++) {
+            schedule.push_back({p, r});
+        }
+    }
+    std::mt19937 gen(seed);
+    std::shuffle(schedule.begin(), schedule.end(), gen);
+    std::cout << "Sweep: " << grid.size() << " points x " << repeat << " runs, " << warmup
+              << " warmups each, order seed " << seed << std::endl;
+
+    std::string results = base.getString("results");
+    bool ok = true;
+    for (size_t i = 0; i < schedule.size(); i++) {
+        Point& p = grid[schedule[i].first];
+        Config c = configFor(p);
+        for (int w = 0; !p.warmed && w < warmup; w++) {
+            std::cout << "Sweep warmup " << w + 1 << "/" << warmup << ": " << describe(p) << std::endl;
+            Record discard;
+            bool warmOk;
+            try {
+                warmOk = runBenchmark(c, discard);
+            } catch (const std::runtime_error& e) {
+                // same as a measured run: counted against the point, and the sweep goes on
+                std::cerr << e.what() << std::endl;
+                warmOk = false;
+            }
+            if (!warmOk) {
+                p.warmupFailed++;
+                ok = false;
+            }
+        }
+        p.warmed = true;
+        std::cout << "Sweep run " << i + 1 << "/" << schedule.size() << ": " << describe(p) << " (repetition "
+                  << schedule[i].second + 1 << ")" << std::endl;
+        Record rec;
+        bool runOk;
+        try {
+            runOk = runBenchmark(c, rec);
+        } catch (const std::runtime_error& e) {
+            // a run that fails at run time is counted; bad settings still abort
+            std::cerr << e.what() << std::endl;
+            rec.add("error", e.what());
+            runOk = false;
+        }
+        rec.add("sweep_point", schedule[i].first);
+        rec.add("repetition", schedule[i].second);
+        if (!rec.append(results)) {
+            std::cerr << "Cannot append to " << results << std::endl;
+        }
+        if (!runOk) {
+            p.failed++;
+            ok = false;
+        }
+        p.runs.push_back(rec);
+    }
+    if (!write(base.getString("sweepout"))) {
+        std::cerr << "Cannot write sweep summary " << base.getString("sweepout") << std::endl;
+        return false;
+    }
+    return ok;
+}
+
+// Record values are kept JSON encoded: strings are quoted, numbers are not
+inline bool Sweep::numeric(const std::string& encoded) {
+    return !encoded.empty() && encoded[0] != '"' && encoded != "true" && encoded != "false" && encoded != "null";
+}
+
+// numeric fields of any run, in first-seen order
+inline std::vector<std::string> Sweep::metrics() const {
+    std::vector<std::string> keys;
+    for (const Point& p : grid) {
+        for (const Record& r : p.runs) {
+            for (const auto& kv : r.fields()) {
+                if (numeric(kv.second) && kv.first != "sweep_point" && kv.first != "repetition" &&
+                    std::find(keys.begin(), keys.end(), kv.first) == keys.end()) {
+                    keys.push_back(kv.first);
+                }
+            }
+        }
+    }
+    return keys;
+}
+
+// two-sided 95% Student t quantile for df degrees of freedom
+inline double Sweep::tQuantile(int df) {
+    static const double t[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    return df <= 30 ? t[df - 1] : 1.960;
+}
+
+// sample standard deviation; one run has no spread to report
+inline Sweep::Stats Sweep::stats(const std::vector<double>& xs) {
+    Stats s{0.0, 0.0, 0.0};
+    if (xs.empty()) {
+        return s;
+    }
+    for (double x : xs) {
+        s.mean += x / xs.size();
+    }
+    if (xs.size() > 1) {
+        double ss = 0.0;
+        for (double x : xs) {
+            ss += (x - s.mean) * (x - s.mean);
+        }
+        s.std = std::sqrt(ss / (xs.size() - 1));
+        s.ci95 = tQuantile(xs.size() - 1) * s.std / std::sqrt((double)xs.size());
+    }
+    return s;
+}
+
+inline bool Sweep::write(const std::string& out) const {
+    std::vector<std::string> keys = metrics();
+    std::vector<std::string> derived = {"parallel_edp_js", "parallel_ed2p_js2"};
+    std::ofstream csv(out + ".csv");
+    std::ofstream jsonl(out + ".jsonl");
+    if (!csv.is_open() || !jsonl.is_open()) {
+        return false;
+    }
+    csv << std::setprecision(9);
+    for (const Axis& a : axes) {
+        csv << a.key << ",";
+    }
+    csv << "runs,failed,warmup_failed";
+    for (const std::vector<std::string>* names : {&derived, &keys}) {
+        for (const std::string& k : *names) {
+            csv << "," << k << "_mean," << k << "_std," << k << "_ci95";
+        }
+    }
+    csv << std::endl;
+
+    for (const Point& p : grid) {
+        Record summary;
+        Config c = configFor(p);
+        for (const auto& kv : c.all()) {
+            summary.add(kv.first, kv.second);
+        }
+        summary.add("order_seed", (long)seed);
+        summary.add("runs", (int)p.runs.size());
+        summary.add("failed", p.failed);
+        summary.add("warmup_failed", p.warmupFailed);
+        for (const std::string& v : p.values) {
+            csv << v << ",";
+        }
+        csv << p.runs.size() << "," << p.failed << "," << p.warmupFailed;
+
+        // package energy times parallel phase time, per run
+        std::vector<double> edp, ed2p;
+        for (const Record& r : p.runs) {
+            double e = r.number("parallel_package_j");
+            double t = r.number("parallel_phase_s");
+            edp.push_back(e * t);
+            ed2p.push_back(e * t * t);
+        }
+        std::vector<std::pair<std::string, Stats>> columns = {{derived[0], stats(edp)}, {derived[1], stats(ed2p)}};
+        for (const std::string& k : keys) {
+            std::vector<double> xs;
+            for (const Record& r : p.runs) {
+                for (const auto& kv : r.fields()) {
+                    if (kv.first == k && numeric(kv.second)) {
+                        xs.push_back(atof(kv.second.c_str()));
+                    }
+                }
+            }
+            columns.push_back({k, stats(xs)});
+        }
+        for (const auto& c : columns) {
+            csv << "," << c.second.mean << "," << c.second.std << "," << c.second.ci95;
+            summary.add(c.first + "_mean", c.second.mean);
+            summary.add(c.first + "_std", c.second.std);
+            summary.add(c.first + "_ci95", c.second.ci95);
+        }
+        csv << std::endl;
+        jsonl << summary.json() << std::endl;
+    }
+    return csv.good() && jsonl.good();
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <sched.h>
+
+#define CPU_ROOT "/sys/devices/system/cpu"
+
+// One logical CPU as sysfs describes it
+struct CpuInfo {
+    int id;
+    int core; // core_id, only unique within a package
+    int package;
+    long maxFreqKhz; // scaling_max_freq, else cpuinfo_max_freq, else 0
+    long capacity; // cpu_capacity: unitless, 1024 for the fastest CPUs; 0 if absent
+    std::vector<int> siblings; // SMT threads sharing the core, including this one
+    int freqClass; // 0 is the fastest class
+};
+
+// The CPUs this process may run on, with their SMT siblings and maximum
+// frequency, grouped into frequency classes. CPUs whose maximum frequency is
+// within 3% of a class's fastest member share its class, so per-core turbo
+// bins do not split a homogeneous part while cores capped with freqcaps=
+// (FrequencyControl) or the P/E cores of a hybrid part land in different
+// classes. Without cpufreq, classes come from cpu_capacity instead, and
+// describe() says so rather than printing it as a frequency.
+class Topology {
+public:
+    Topology(const std::string& root = CPU_ROOT);
+
+    const std::vector<CpuInfo>& cpus() const;
+    const CpuInfo& cpu(int id) const;
+    int classCount() const;
+    std::vector<int> classCpus(int freqClass) const;
+    std::string describe() const;
+    bool classedByCapacity() const;
+
+    static std::vector<int> parseList(const std::string& list);
+
+private:
+    std::vector<CpuInfo> all; // ascending id
+    int classes;
+    bool byCapacity; // no CPU reports a frequency, so classes rank cpu_capacity
+
+    static bool readLong(const std::string& path, long& value);
+    static std::string readLine(const std::string& path);
+};
+
+inline bool Topology::readLong(const std::string& path, long& value) {
+    std::ifstream in(path);
+    return (bool)(in >> value);
+}
+
+inline std::string Topology::readLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// Kernel cpu list format: "0-3,8,10-11"
+inline std::vector<int> Topology::parseList(const std::string& list) {
+    std::vector<int> ids;
+    std::stringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        if (range.find_first_not_of(" \t\r\n") == std::string::npos) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int lo = std::stoi(range.substr(0, dash));
+        int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+        for (int i = lo; i <= hi; i++) {
+            ids.push_back(i);
+        }
+    }
+    return ids;
+}
+
+inline Topology::Topology(const std::string& root) {
+    std::vector<int> online = parseList(readLine(root + "/online"));
+    if (online.empty()) {
+        throw std::runtime_error("Cannot read the online CPU list under " + root);
+    }
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    for (int id : online) {
+        if (haveMask && id < CPU_SETSIZE && !CPU_ISSET(id, &allowed)) {
+            continue; // outside our cpuset, pinning there would fail
+        }
+        std::string dir = root + "/cpu" + std::to_string(id);
+        CpuInfo c;
+        c.id = id;
+        long v;
+        c.core = readLong(dir + "/topology/core_id", v) ? (int)v : id;
+        c.package = readLong(dir + "/topology/physical_package_id", v) ? (int)v : 0;
+        if (!readLong(dir + "/cpufreq/scaling_max_freq", c.maxFreqKhz) &&
+            !readLong(dir + "/cpufreq/cpuinfo_max_freq", c.maxFreqKhz)) {
+            c.maxFreqKhz = 0;
+        }
+        if (!readLong(dir + "/cpu_capacity", c.capacity)) {
+            c.capacity = 0;
+        }
+        c.siblings = parseList(readLine(dir + "/topology/thread_siblings_list"));
+        if (c.siblings.empty()) {
+            c.siblings.push_back(id);
+        }
+        c.freqClass = 0;
+        all.push_back(c);
+    }
+    if (all.empty()) {
+        throw std::runtime_error("None of the online CPUs under " + root + " are in this process's affinity mask");
+    }
+
+    byCapacity = true;
+    for (const CpuInfo& c : all) {
+        if (c.maxFreqKhz > 0) {
+            byCapacity = false;
+        }
+    }
+    std::vector<long> freqs;
+    for (const CpuInfo& c : all) {
+        freqs.push_back(byCapacity ? c.capacity : c.maxFreqKhz);
+    }
+    std::sort(freqs.rbegin(), freqs.rend());
+    std::vector<long> tops; // fastest frequency of each class
+    for (long f : freqs) {
+        if (tops.empty() || f < tops.back() * 0.97) {
+            tops.push_back(f);
+        }
+    }
+    classes = tops.size();
+    for (CpuInfo& c : all) {
+        long f = byCapacity ? c.capacity : c.maxFreqKhz;
+        while (c.freqClass + 1 < classes && f <= tops[c.freqClass + 1]) {
+            c.freqClass++;
+        }
+    }
+}
+
+inline const std::vector<CpuInfo>& Topology::cpus() const {
+    return all;
+}
+
+inline const CpuInfo& Topology::cpu(int id) const {
+    for (const CpuInfo& c : all) {
+        if (c.id == id) {
+            return c;
+        }
+    }
+    throw std::out_of_range("CPU " + std::to_string(id) + " is not available");
+}
+
+inline int Topology::classCount() const {
+    return classes;
+}
+
+inline std::vector<int> Topology::classCpus(int freqClass) const {
+    std::vector<int> ids;
+    for (const CpuInfo& c : all) {
+        if (c.freqClass == freqClass) {
+            ids.push_back(c.id);
+        }
+    }
+    return ids;
+}
+
+// true when the classes rank cpu_capacity because no CPU reports a frequency
+inline bool Topology::classedByCapacity() const {
+    return byCapacity;
+}
+
+// e.g. "16 CPUs, 2 classes: [0] 5300 MHz x8 [1] 800 MHz x8", or
+// "[0] capacity 1024 x4" when classed by cpu_capacity
+inline std::string Topology::describe() const {
+    std::ostringstream out;
+    out << all.size() << " CPUs, " << classes << " frequency classes:";
+    for (int k = 0; k < classes; k++) {
+        std::vector<int> ids = classCpus(k);
+        const CpuInfo& top = cpu(ids[0]);
+        out << " [" << k << "] ";
+        if (byCapacity) {
+            out << "capacity " << top.capacity;
+        } else {
+            out << top.maxFreqKhz / 1000 << " MHz";
+        }
+        out << " x" << ids.size();
+    }
+    return out.str();
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// One pre-generated operation. What a and b mean depends on the kind:
+//   DEPOSIT  - from and to account; fraction scales the amount onto the
+//              from balance once the locks are held (scaleFraction)
+//   AUDIT    - nothing
+//   GET      - list index
+//   SET      - list index and value
+//   CONTAINS - value searched for
+//   ADD      - value appended
+enum TraceKind : uint8_t { TRACE_DEPOSIT, TRACE_AUDIT, TRACE_GET, TRACE_SET, TRACE_CONTAINS, TRACE_ADD };
+enum TraceFlag : uint8_t { TRACE_HOT = 1 }; // touches a key of the distribution's hot set
+
+struct TraceOp {
+    uint8_t kind;
+    uint8_t flags;
+    uint8_t unused[2];
+    int32_t a;
+    int32_t b;
+    uint32_t fraction;
+};
+static_assert(sizeof(TraceOp) == 16, "TraceOp is the on-disk record");
+
+// Binary operation trace: a header, one (offset, count) entry per thread,
+// then each thread's TraceOps back to back. Files are native-endian and
+// meant to be replayed on the machine family that wrote them. Replay maps the
+// file read-only and hands out pointers into it, so there is nothing to parse
+// and every run of a trace issues the same operations from the same threads
+// whatever the lock policy or placement.
+class Trace {
+public:
+    Trace(const std::string& path);
+    ~Trace();
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    static void write(const std::string& path, const std::vector<std::vector<TraceOp>>& streams, uint64_t seed);
+    int threads() const;
+    const TraceOp* ops(int thread) const;
+    long count(int thread) const;
+    long total() const;
+    uint64_t seed() const;
+
+private:
+    static const uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8]; // "BTRACE\0\0"
+        uint32_t version;
+        uint32_t threads;
+        uint64_t seed;
+    };
+    struct Stream {
+        uint64_t offset; // bytes from the start of the file
+        uint64_t count;
+    };
+
+    void* base;
+    size_t length;
+    const Header* header;
+    const Stream* streams;
+};
+
+inline void Trace::write(const std::string& path, const std::vector<std::vector<TraceOp>>& streams, uint64_t seed) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        throw std::runtime_error("Cannot create trace " + path + ": " + strerror(errno));
+    }
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "BTRACE", 6);
+    h.version = VERSION;
+    h.threads = streams.size();
+    h.seed = seed;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    uint64_t offset = sizeof(Header) + streams.size() * sizeof(Stream);
+    for (const std::vector<TraceOp>& s : streams) {
+        Stream e{offset, s.size()};
+        ok = ok && fwrite(&e, sizeof(e), 1, f) == 1;
+        offset += s.size() * sizeof(TraceOp);
+    }
+    for (const std::vector<TraceOp>& s : streams) {
+        ok = ok && fwrite(s.data(), sizeof(TraceOp), s.size(), f) == s.size();
+    }
+    if (fclose(f) != 0 || !ok) {
+        throw std::runtime_error("Cannot write trace " + path);
+    }
+}
+
+inline Trace::Trace(const std::string& path) : base(MAP_FAILED), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open trace " + path + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header)) {
+        length = st.st_size;
+        // populated up front so replay does not fault pages in on the clock
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Cannot map trace " + path);
+    }
+    header = static_cast<const Header*>(base);
+    streams = reinterpret_cast<const Stream*>(header + 1);
+    bool valid = memcmp(header->magic, "BTRACE", 6) == 0 && header->version == VERSION &&
+                 sizeof(Header) + header->threads * sizeof(Stream) <= length;
+    for (uint32_t t = 0; valid && t < header->threads; t++) {
+        valid = streams[t].offset % alignof(TraceOp) == 0 &&
+                streams[t].offset + streams[t].count * sizeof(TraceOp) <= length;
+    }
+    if (!valid) {
+        munmap(base, length);
+        throw std::runtime_error("Not a valid trace file: " + path);
+    }
+}
+
+inline Trace::~Trace() {
+    munmap(base, length);
+}
+
+inline int Trace::threads() const {
+    return header->threads;
+}
+
+inline const TraceOp* Trace::ops(int thread) const {
+    return reinterpret_cast<const TraceOp*>(static_cast<const char*>(base) + streams[thread].offset);
+}
+
+inline long Trace::count(int thread) const {
+    return streams[thread].count;
+}
+
+inline long Trace::total() const {
+    long n = 0;
+    for (int t = 0; t < threads(); t++) {
+        n += count(t);
+    }
+    return n;
+}
+
+// the seed the trace was generated from
+inline uint64_t Trace::seed() const {
+    return header->seed;
+}
+
+// A thread's position in its stream. A thread that runs past its end (the
+// governor's shared pool can hand one thread more than its share) starts over.
+class TraceCursor {
+public:
+    TraceCursor(const Trace* trace = nullptr, int thread = 0);
+    bool replaying() const;
+    const TraceOp& next();
+
+private:
+    const TraceOp* ops;
+    long count;
+    long at;
+};
+
+inline TraceCursor::TraceCursor(const Trace* trace, int thread) : ops(nullptr), count(0), at(0) {
+    if (trace != nullptr && thread < trace->threads() && trace->count(thread) > 0) {
+        ops = trace->ops(thread);
+        count = trace->count(thread);
+    }
+}
+
+inline bool TraceCursor::replaying() const {
+    return ops != nullptr;
+}
+
+inline const TraceOp& TraceCursor::next() {
+    if (at == count) {
+        at = 0;
+    }
+    return ops[at++];
+}
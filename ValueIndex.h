@@ -0,0 +1,113 @@
+#pragma once
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
+
+// Concurrent multiset of values: how many times each value is stored, kept
+// in shards of hash maps each under its own shared_mutex. Lookups cost one
+// hash and one shared lock whatever the number of values. Values whose count
+// drops to zero are erased, so memory follows the distinct values present.
+template <typename T>
+class ValueIndex {
+public:
+    ValueIndex(int _shards);
+
+    void add(T value, long delta);
+    long count(T value);
+    long distinct();
+    long bytes();
+    long updates();
+
+private:
+    struct alignas(64) Shard {
+        std::shared_mutex lock;
+        std::unordered_map<T, long> counts;
+        long updates = 0;
+    };
+
+    int shards;
+    int shift;
+    std::unique_ptr<Shard[]> table;
+
+    Shard& shardFor(T value);
+};
+
+template <typename T>
+ValueIndex<T>::ValueIndex(int _shards) {
+    if (_shards < 1) {
+        throw std::invalid_argument("A value index needs at least one shard");
+    }
+    shards = 1;
+    shift = 64;
+    while (shards < _shards) {
+        shards <<= 1;
+        shift--;
+    }
+    table.reset(new Shard[shards]);
+}
+
+// Fibonacci hashing on top of std::hash, which is the identity for integers
+template <typename T>
+typename ValueIndex<T>::Shard& ValueIndex<T>::shardFor(T value) {
+    uint64_t h = std::hash<T>()(value) * 0x9e3779b97f4a7c15ULL;
+    return table[shards > 1 ? h >> shift : 0];
+}
+
+template <typename T>
+void ValueIndex<T>::add(T value, long delta) {
+    Shard& s = shardFor(value);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    long& n = s.counts[value];
+    n += delta;
+    if (n <= 0) {
+        s.counts.erase(value);
+    }
+    s.updates++;
+}
+
+template <typename T>
+long ValueIndex<T>::count(T value) {
+    Shard& s = shardFor(value);
+    std::shared_lock<std::shared_mutex> guard(s.lock);
+    auto it = s.counts.find(value);
+    return it == s.counts.end() ? 0 : it->second;
+}
+
+template <typename T>
+long ValueIndex<T>::distinct() {
+    long n = 0;
+    for (int i = 0; i < shards; i++) {
+        std::shared_lock<std::shared_mutex> guard(table[i].lock);
+        n += table[i].counts.size();
+    }
+    return n;
+}
+
+// Approximate heap and table footprint: the shards, each map's bucket array
+// and one node per value (the entry plus the next pointer and cached hash of
+// libstdc++'s nodes)
+template <typename T>
+long ValueIndex<T>::bytes() {
+    long total = shards * sizeof(Shard);
+    for (int i = 0; i < shards; i++) {
+        std::shared_lock<std::shared_mutex> guard(table[i].lock);
+        total += table[i].counts.bucket_count() * sizeof(void*);
+        total += table[i].counts.size() * (sizeof(std::pair<const T, long>) + sizeof(void*) + sizeof(size_t));
+    }
+    return total;
+}
+
+// count changes applied, each one exclusive acquisition of a shard
+template <typename T>
+long ValueIndex<T>::updates() {
+    long n = 0;
+    for (int i = 0; i < shards; i++) {
+        std::shared_lock<std::shared_mutex> guard(table[i].lock);
+        n += table[i].updates;
+    }
+    return n;
+}
@@ -0,0 +1,34 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "Bench.h"
+#include "Sweep.h"
+
+// ./bench [key=value ...] [config=file]; ./bench help lists every setting
+int main(int argc, char **argv) {
+    Config cfg;
+    if (!cfg.parse(argc, argv)) {
+        return 1;
+    }
+    if (!cfg.getString("sweep").empty()) {
+        try {
+            return Sweep(cfg).run() ? 0 : 2;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    Record rec;
+    bool ok;
+    try {
+        ok = runBenchmark(cfg, rec);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (!rec.append(cfg.getString("results"))) {
+        std::cerr << "Cannot append to " << cfg.getString("results") << std::endl;
+        return 1;
+    }
+    return ok ? 0 : 2;
+}
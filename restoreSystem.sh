@@ -1,29 +0,0 @@
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu16/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu17/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu18/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu19/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu20/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu21/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu22/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu23/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu24/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu25/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu26/cpufreq/scaling_max_freq
-echo 4200000 | sudo tee /sys/devices/system/cpu/cpu27/cpufreq/scaling_max_freq
-
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu1/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu2/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu3/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu4/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu5/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu6/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu7/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu8/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu9/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu10/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu11/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu12/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu13/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu14/cpufreq/scaling_max_freq
-echo 5300000 | sudo tee /sys/devices/system/cpu/cpu15/cpufreq/scaling_max_freq
@@ -1,10 +1,7 @@
-# rm test2
-# # rm bank
-# g++ -std=c++17 -o test2 test.cpp -g -pthread -O3
-# # sh cores.sh
-# # g++ -std=c++17 -o bank bank.cpp -pthread -O3
-# sudo ./test2
-# # sudo ./bank
+# rm bench
+# g++ -std=c++17 -o bench bench.cpp -g -pthread -O3
+# sudo ./bench workload=list
+# # sudo ./bench workload=bank lock=mcs
 
-sh cores.sh
-sudo ./test2
\ No newline at end of file
+# CPUs 0-25 capped at 1.2 GHz and 26-27 at 4.2 GHz for the run only; bench restores them
+sudo ./bench workload=list freqcaps=0-25:1200000/26-27:4200000
@@ -1,13 +1,10 @@
 git stash
 git pull
 
-rm test2
-# rm bank
-g++ -std=c++17 -o test2 test.cpp -g -pthread -O3
-# sh cores.sh
-# g++ -std=c++17 -o bank bank.cpp -pthread -O3
-# ./test2
-# sudo ./bank
+rm bench
+g++ -std=c++17 -o bench bench.cpp -g -pthread -O3
+# sudo ./bench workload=bank
+# ./bench workload=list
 
 git add .
 git commit -m "recompile"